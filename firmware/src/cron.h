@@ -0,0 +1,123 @@
+#pragma once
+// Agendador: entradas, cron ("m h dom mon dow") e pinos aceitos como gatilho.
+// Sem FreeRTOS: a task/ISR ficam no main.cpp; isto roda também nos testes de host (firmware/test/host).
+#include <Arduino.h>
+#include <time.h>
+
+enum SchedKind : uint8_t { SK_CRON, SK_IN, SK_GPIO, SK_EVENT };
+struct SchedEntry {
+  uint8_t  kind;
+  bool     on;
+  int8_t   pin;
+  uint8_t  edge;       // RISING | FALLING
+  uint64_t mMin;       // bit 0..59
+  uint32_t mHour;      // bit 0..23
+  uint32_t mDom;       // bit 1..31
+  uint16_t mMon;       // bit 1..12
+  uint8_t  mDow;       // bit 0..6
+  bool     domAny, dowAny;
+  uint32_t inSec;
+  char     name[16];
+  long     loops;      // 0 = infinito
+};
+
+static bool allDigits(const String& s){
+  if(!s.length()) return false;
+  for(size_t i=0;i<s.length();i++) if(s[i]<'0'||s[i]>'9') return false;
+  return true;
+}
+// Um campo cron em máscara de bits; false se inválido.
+bool cronField(const String& f, int lo, int hi, uint64_t& mask){
+  mask=0;
+  int start=0;
+  while(true){
+    int comma=f.indexOf(',',start);
+    String part = comma<0 ? f.substring(start) : f.substring(start,comma);
+    int step=1, a, b;
+    int sl=part.indexOf('/');
+    if(sl>=0){
+      String st=part.substring(sl+1);
+      if(!allDigits(st) || (step=st.toInt())<1) return false;
+      part=part.substring(0,sl);
+    }
+    if(part=="*"){ a=lo; b=hi; }
+    else{
+      int dash=part.indexOf('-');
+      String pa = dash<0 ? part : part.substring(0,dash);
+      String pb = dash<0 ? part : part.substring(dash+1);
+      if(!allDigits(pa) || !allDigits(pb)) return false;
+      a=pa.toInt(); b=pb.toInt();
+      if(dash<0 && sl>=0) b=hi;   // "5/15" = de 5 em diante
+    }
+    if(a<lo || b>hi || a>b) return false;
+    for(int v=a; v<=b; v+=step) mask |= 1ULL<<v;
+    if(comma<0) break;
+    start=comma+1;
+  }
+  return true;
+}
+// Algum mês escolhido tem um dos dias escolhidos? (só importa quando o dow é "*": com os dois
+// restritos vale o OU e o dow sempre acontece). Fev conta 29: "0 0 29 2 *" dispara nos bissextos.
+bool cronPossible(const SchedEntry& e){
+  static const uint8_t MDAYS[12] = {31,29,31,30,31,30,31,31,30,31,30,31};
+  if(e.domAny || !e.dowAny) return true;
+  for(int m=1;m<=12;m++){
+    if(!(e.mMon & (1u<<m))) continue;
+    for(int d=1; d<=MDAYS[m-1]; d++) if(e.mDom & (1UL<<d)) return true;
+  }
+  return false;
+}
+bool cronParse(const String& spec, SchedEntry& e){
+  String f[5]; int n=0, i=0;
+  while(n<5){
+    while(i<(int)spec.length() && spec[i]==' ') i++;
+    if(i>=(int)spec.length()) break;
+    int j=spec.indexOf(' ', i);
+    f[n++] = j<0 ? spec.substring(i) : spec.substring(i,j);
+    if(j<0) break;
+    i=j;
+  }
+  if(n!=5) return false;
+  uint64_t mi, h, dom, mon, dow;
+  if(!cronField(f[0],0,59,mi) || !cronField(f[1],0,23,h) || !cronField(f[2],1,31,dom)
+     || !cronField(f[3],1,12,mon) || !cronField(f[4],0,7,dow)) return false;
+  e.mMin=mi; e.mHour=(uint32_t)h; e.mDom=(uint32_t)dom; e.mMon=(uint16_t)mon;
+  e.mDow=(uint8_t)((dow | (dow>>7)) & 0x7F);  // 7 = domingo = 0
+  e.domAny = (f[2]=="*"); e.dowAny = (f[4]=="*");
+  return cronPossible(e);   // "0 0 31 2 *" nunca dispara: recusa em vez de armar para sempre
+}
+
+// Próximo instante (epoch, hora local) estritamente depois de `after`; 0 se nunca.
+time_t cronNext(const SchedEntry& e, time_t after){
+  struct tm t; localtime_r(&after, &t);
+  t.tm_sec=0; t.tm_min++;
+  auto norm=[&](){ t.tm_isdst=-1; return mktime(&t); };
+  norm();
+  for(int guard=0; guard<4000; guard++){   // saltos de mês/dia/hora: cobre vários anos
+    if(!(e.mMon & (1u<<(t.tm_mon+1)))){ t.tm_mon++; t.tm_mday=1; t.tm_hour=0; t.tm_min=0; norm(); continue; }
+    bool domOk = e.mDom & (1UL<<t.tm_mday);
+    bool dowOk = e.mDow & (1u<<t.tm_wday);
+    bool dayOk = (e.domAny || e.dowAny) ? (domOk && dowOk) : (domOk || dowOk);
+    if(!dayOk){ t.tm_mday++; t.tm_hour=0; t.tm_min=0; norm(); continue; }
+    if(!(e.mHour & (1UL<<t.tm_hour))){ t.tm_hour++; t.tm_min=0; norm(); continue; }
+    if(!(e.mMin & (1ULL<<t.tm_min))){ t.tm_min++; norm(); continue; }
+    return norm();
+  }
+  return 0;
+}
+
+// GPIOs que não podem virar gatilho no S3: USB D-/D+ (19/20, o próprio HID), 22-25 (não existem),
+// flash/PSRAM (26-32), o LED RGB da DevKitC-1 (48) e os pinos do LED de status da build.
+bool schedPinOk(int p){
+  if(p<0 || p>48) return false;
+  if(p==19 || p==20) return false;
+  if(p>=22 && p<=32) return false;
+  if(p==48) return false;
+#if defined(NEOPIXEL_PIN)
+  if(p==NEOPIXEL_PIN) return false;
+#endif
+#if defined(USE_RGB_GPIO)
+  if(p==LED_R || p==LED_G || p==LED_B) return false;
+#endif
+  return true;
+}
@@ -0,0 +1,75 @@
+#pragma once
+// Descritores HID extras (digitizer multi-touch e roda de alta resolução) e o layout dos reports.
+// Sem dependência de Arduino: os testes de host (firmware/test/host) conferem bytes x structs.
+#include <stdint.h>
+
+// Contatos do digitizer
+static const uint8_t  TOUCH_MAX = 5;
+static const uint16_t TOUCH_LOGICAL_MAX = 32767;
+
+// Digitizer multi-touch (touchscreen) no mesmo USBHID: TOUCH_MAX contatos por report
+// ("parallel mode"), X/Y absolutos 0..TOUCH_LOGICAL_MAX. Contact Count Maximum via feature report.
+enum { HID_REPORT_ID_TOUCH = 0x20, HID_REPORT_ID_TOUCH_MAX = 0x21 };
+
+#define TOUCH_FINGER \
+  0x05,0x0D, 0x09,0x22, 0xA1,0x02,                       /* Finger (logical)       */ \
+  0x09,0x42, 0x15,0x00, 0x25,0x01, 0x75,0x01, 0x95,0x01, /* Tip Switch             */ \
+  0x81,0x02, 0x95,0x07, 0x81,0x03,                       /* + 7 bits de padding    */ \
+  0x09,0x51, 0x25,0x7F, 0x75,0x08, 0x95,0x01, 0x81,0x02, /* Contact Identifier     */ \
+  0x05,0x01, 0x26,0xFF,0x7F, 0x75,0x10,                  /* X/Y 0..32767, 16 bits  */ \
+  0x55,0x0E, 0x65,0x11, 0x35,0x00,                       /* cm, expoente -2        */ \
+  0x46,0x40,0x06, 0x09,0x30, 0x81,0x02,                  /* X (16,00 cm nominal)   */ \
+  0x46,0x84,0x03, 0x09,0x31, 0x81,0x02,                  /* Y (9,00 cm nominal)    */ \
+  0x65,0x00, 0x55,0x00, 0x45,0x00,                       /* zera unidades          */ \
+  0xC0
+
+static const uint8_t touchDesc[] = {
+  0x05,0x0D, 0x09,0x04, 0xA1,0x01,           // Digitizer / Touch Screen (application)
+  0x85,HID_REPORT_ID_TOUCH,
+  TOUCH_FINGER, TOUCH_FINGER, TOUCH_FINGER, TOUCH_FINGER, TOUCH_FINGER,
+  0x05,0x0D, 0x09,0x54, 0x25,0x7F, 0x75,0x08, 0x95,0x01, 0x81,0x02,   // Contact Count
+  0x85,HID_REPORT_ID_TOUCH_MAX,
+  0x09,0x55, 0x25,TOUCH_MAX, 0xB1,0x02,     // Contact Count Maximum (feature)
+  0xC0
+};
+
+struct __attribute__((packed)) TouchContact { uint8_t tip; uint8_t id; uint16_t x, y; };
+struct __attribute__((packed)) TouchReport  { TouchContact c[TOUCH_MAX]; uint8_t count; };
+static_assert(sizeof(TouchReport) == TOUCH_MAX*6 + 1, "layout do report de toque");
+
+// Roda/pan de alta resolução: Resolution Multiplier (feature) até 120 unidades por notch.
+// Se o host não habilitar o multiplicador, hidExec converte as unidades em notches inteiros.
+static const int WHEEL_DELTA = 120;
+enum { HID_REPORT_ID_WHEEL = 0x22, HID_REPORT_ID_WHEEL_MULT = 0x23 };
+static const uint8_t wheelDesc[] = {
+  0x05,0x01, 0x09,0x02, 0xA1,0x01,           // Generic Desktop / Mouse (application)
+  0x09,0x01, 0xA1,0x00,                      //   Pointer (physical)
+  0xA1,0x02,                                 //     Logical (roda vertical)
+  0x85,HID_REPORT_ID_WHEEL_MULT,
+  0x09,0x48, 0x15,0x00, 0x25,0x01, 0x35,0x01, 0x45,WHEEL_DELTA, 0x75,0x02, 0x95,0x01,
+  0xA4, 0xB1,0x02,                           //       Resolution Multiplier (push)
+  0x85,HID_REPORT_ID_WHEEL,
+  0x09,0x38, 0x35,0x00, 0x45,0x00,           //       Wheel, 16 bits relativo
+  0x16,0x01,0x80, 0x26,0xFF,0x7F, 0x75,0x10, 0x81,0x06,
+  0xC0,
+  0xA1,0x02,                                 //     Logical (pan)
+  0x85,HID_REPORT_ID_WHEEL_MULT,
+  0xB4, 0x09,0x48, 0xB1,0x02,                //       Resolution Multiplier (pop)
+  0x35,0x00, 0x45,0x00, 0x75,0x04, 0xB1,0x03,//       padding do feature
+  0x85,HID_REPORT_ID_WHEEL,
+  0x05,0x0C, 0x0A,0x38,0x02,                 //       AC Pan, 16 bits relativo
+  0x16,0x01,0x80, 0x26,0xFF,0x7F, 0x75,0x10, 0x95,0x01, 0x81,0x06,
+  0xC0,
+  0xC0,
+  0xC0
+};
+struct __attribute__((packed)) WheelReport { int16_t wheel, pan; };
+
+// Converte unidades de alta resolução para o que o host habilitou (guarda o resto em acc).
+inline int16_t wheelUnits(int16_t units, bool hiRes, int& acc){
+  if(hiRes) return units;
+  acc += units;
+  int n = acc / WHEEL_DELTA;
+  acc -= n * WHEEL_DELTA;
+  return (int16_t)n;
+}
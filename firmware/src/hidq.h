@@ -0,0 +1,91 @@
+#pragma once
+// Ops da fila HID: o que o interpretador (produtor) emite e a hidPump (consumidor) executa.
+// Sem dependência de Arduino: usado também pelos testes de host (firmware/test/host).
+#include <stdint.h>
+#include <atomic>
+
+// Fases da timeline (OP_PHASE); nomes em PHASE_NAMES (trace.h).
+enum TracePhase : uint8_t { PH_START, PH_HOME, PH_MOVE, PH_BUTTON, PH_TEXT, PH_KEY, PH_DELAY, PH_TOUCH, PH_SCROLL, PH_COUNT };
+
+// TOUCH só atualiza um contato no report sombra; TFRAME envia o report com todos de uma vez.
+// WHEEL leva unidades de 1/WHEEL_DELTA notch; CPRESS leva o usage de consumer em x.
+enum HidOpCode : uint8_t { OP_MOVE, OP_PRESS, OP_RELEASE, OP_KPRESS, OP_KRELEASE, OP_WAIT, OP_PHASE, OP_STEP, OP_SYNC,
+                           OP_TOUCH, OP_TFRAME, OP_WHEEL, OP_CPRESS, OP_CRELEASE };
+struct HidOp {
+  uint8_t  op;
+  uint8_t  a;      // botão / tecla / fase / contato / nº de contatos do frame
+  int16_t  x, y;   // delta do MOVE; posição absoluta do TOUCH; pan/roda do WHEEL; usage do CPRESS;
+                   // x = início(1)/fim(0) da fase; x = índice do passo
+  uint16_t ms;     // WAIT; tip switch do TOUCH
+};
+
+// ===== Fila SPSC de ops =====
+// Produtor: interpretador (runner). Consumidor: hidPump. Só índices atômicos, sem lock.
+// Os dois lados dormem em notificação: o consumidor com a fila vazia (idle), o produtor com ela cheia
+// (prodWaiting); quem libera/enche acorda o outro. O FreeRTOS fica no main.cpp, aqui só a lógica.
+
+template<uint32_t CAP, uint32_t PREFILL>
+class HidRing {
+  static_assert(CAP && !(CAP & (CAP-1)), "CAP tem que ser potência de 2");
+  static_assert(PREFILL < CAP, "PREFILL >= CAP nunca começa a drenar");
+public:
+  static const uint32_t WAKE_AT = CAP/2;  // produtor volta quando sobra meia fila: rajada, não op a op
+
+  std::atomic<bool> primed{false};       // consumidor pode drenar (prefill atingido ou stream fechado)
+  std::atomic<bool> open{false};         // stream aberto: fila vazia aqui é underrun
+  std::atomic<bool> consIdle{false};     // consumidor dormindo esperando op
+  std::atomic<bool> prodWaiting{false};  // produtor dormindo esperando espaço
+  volatile uint32_t maxDepth = 0;
+  volatile uint32_t underruns = 0;       // episódios (não voltas do consumidor) de fila vazia no meio do stream
+
+  uint32_t depth() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+  bool full() const { return depth() >= CAP; }
+
+  void begin(){ primed=false; open=true; }
+  void end(){ open=false; primed=true; }
+
+  // Produtor. false = cheia (nada escrito).
+  bool push(const HidOp& o){
+    const uint32_t h = head.load(std::memory_order_relaxed);
+    const uint32_t d = h - tail.load(std::memory_order_acquire);
+    if(d >= CAP) return false;
+    buf[h & (CAP-1)] = o;
+    head.store(h+1, std::memory_order_release);
+    if(d+1 > maxDepth) maxDepth = d+1;
+    if(!primed.load(std::memory_order_relaxed) && d+1 >= PREFILL) primed = true;
+    return true;
+  }
+
+  // Consumidor. false = nada a drenar (não primed ou vazia); conta o underrun uma vez por episódio.
+  bool pop(HidOp& o){
+    const uint32_t t = tail.load(std::memory_order_relaxed);
+    if(!primed.load() || t == head.load(std::memory_order_acquire)){
+      if(primed.load() && open.load() && !starving){ starving = true; underruns++; }
+      return false;
+    }
+    starving = false;
+    o = buf[t & (CAP-1)];
+    tail.store(t+1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumidor, depois de um pop: true uma única vez quando o produtor espera e já há espaço.
+  bool wakeProducer(){
+    return prodWaiting.load() && depth() <= WAKE_AT && prodWaiting.exchange(false);
+  }
+
+  // Consumidor (stop): descarta tudo, chamando f em cada op descartada.
+  template<class F> void drain(F f){
+    const uint32_t h = head.load(std::memory_order_acquire);
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    for(; t!=h; t++) f(buf[t & (CAP-1)]);
+    tail.store(t, std::memory_order_release);
+    starving = false;
+  }
+
+private:
+  HidOp buf[CAP];
+  std::atomic<uint32_t> head{0};  // só o produtor escreve
+  std::atomic<uint32_t> tail{0};  // só o consumidor escreve
+  bool starving = false;          // só o consumidor
+};
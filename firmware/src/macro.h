@@ -0,0 +1,476 @@
+#pragma once
+// Macro: modelo de passos, tradução passo -> ops HID (produtor) e otimizador.
+// Não fala com o HID nem com a fila: tudo sai por hidEmit(), definido no main.cpp
+// (e por um gravador de ops nos testes de host, firmware/test/host).
+#include <Arduino.h>
+#include <USBHIDMouse.h>
+#include <USBHIDKeyboard.h>
+#include <math.h>
+#include <vector>
+#include "hidq.h"
+#include "hid_desc.h"
+
+// ================= Modelo de passos =================
+// type: "tap" | "drag" | "type" | "key" | "wait" | "touch" | "pinch" | "scroll" | "consumer"
+struct Step {
+  String type;
+  int x=0, y=0, x2=0, y2=0;
+  String text;        // para type/key/consumer; contatos do touch ("x,y>x,y;x,y")
+  String btn="left";  // "left" | "right" | "middle"
+  int delayMs=0;      // delay POS-ação (se 0, usa actionDelay global)
+  int durMs=0;        // duração do DRAG/gesto (ms)
+  int stepsN=1;       // passos do DRAG / frames do gesto / reports do scroll / repetições do consumer
+  int  jit=-1;        // jitter do delay: -1 = global; 0 = sem jitter neste passo; >0 = ±% próprio
+};
+
+// Jitter "humanizado", determinístico por seed
+enum JitDist : uint8_t { JD_UNIFORM, JD_TRI };
+struct JitterCfg {
+  bool     on = false;
+  uint32_t seed = 1;
+  uint8_t  dist = JD_UNIFORM;        // uniforme | triangular (aprox. normal)
+  int      delayPct = 10;            // ± % no delay pós-ação
+  int      holdMin = 25, holdMax = 25;   // segura do clique (ms)
+  int      charMin = 5,  charMax = 5;    // intervalo entre caracteres (ms)
+  int      posPx = 0;                // ± px no alvo de TAP/DRAG
+};
+
+// Config (definida no main.cpp)
+extern int   screenW, screenH;
+extern float countsPerPixel;
+extern int   actionDelay;
+extern JitterCfg jitter;
+
+// ================= Forma canônica / CRC =================
+// Forma canônica de um passo (campos separados por 0x1F) e CRC32 IEEE: base dos deltas de macro.
+// Deve bater com canon() em go-fleet.
+String stepCanon(const Step& st){
+  const char US = '\x1f';
+  String c = st.type; c += US;
+  c += st.x; c += US; c += st.y; c += US; c += st.x2; c += US; c += st.y2; c += US;
+  c += st.text; c += US; c += st.btn; c += US;
+  c += st.delayMs; c += US; c += st.durMs; c += US; c += st.stepsN; c += US;
+  c += st.jit;
+  return c;
+}
+uint32_t crc32Update(uint32_t crc, const uint8_t* p, size_t n){
+  crc = ~crc;
+  while(n--){ crc ^= *p++; for(int k=0;k<8;k++) crc = (crc>>1) ^ (0xEDB88320u & (0u - (crc & 1))); }
+  return ~crc;
+}
+uint32_t stepCrc(const Step& st){ String c=stepCanon(st); return crc32Update(0, (const uint8_t*)c.c_str(), c.length()); }
+uint32_t macroCrc(const Step* p, int n){
+  uint32_t crc=0;
+  for(int i=0;i<n;i++){ String c=stepCanon(p[i]); c += '\n'; crc = crc32Update(crc, (const uint8_t*)c.c_str(), c.length()); }
+  return crc;
+}
+String hex32(uint32_t v){ char b[9]; snprintf(b, sizeof(b), "%08x", (unsigned)v); return String(b); }
+
+// ================= HID helpers =================
+// Todo acesso ao HID vira op na fila (ou roda inline no dry-run): hidEmit() fica no main.cpp.
+void hidEmit(const HidOp& o);
+
+void hidMove(int dx, int dy){ hidEmit(HidOp{OP_MOVE,0,(int16_t)dx,(int16_t)dy,0}); }
+void hidPress(uint8_t m){ hidEmit(HidOp{OP_PRESS,m,0,0,0}); }
+void hidRelease(uint8_t m){ hidEmit(HidOp{OP_RELEASE,m,0,0,0}); }
+void kbPress(uint8_t k){ hidEmit(HidOp{OP_KPRESS,k,0,0,0}); }
+void kbRelease(uint8_t k){ hidEmit(HidOp{OP_KRELEASE,k,0,0,0}); }
+void kbWrite(uint8_t k){ kbPress(k); kbRelease(k); }
+void hidWait(int ms){
+  while(ms > 0){ int c = min(ms, 60000); hidEmit(HidOp{OP_WAIT,0,0,0,(uint16_t)c}); ms -= c; }
+}
+void hidStep(int i){ hidEmit(HidOp{OP_STEP,0,(int16_t)i,0,0}); }
+void phaseBegin(uint8_t ph){ hidEmit(HidOp{OP_PHASE,ph,1,0,0}); }
+void phaseEnd(){ hidEmit(HidOp{OP_PHASE,0,0,0,0}); }
+
+void homeCursor(){
+  for(int i=0;i<30;i++){ hidMove(-127,-127); hidWait(1); }
+}
+void moveRelCounts(long dx, long dy){
+  long rx=dx, ry=dy;
+  while(rx!=0 || ry!=0){
+    int sx = (rx>0) ? (int)min<long>(rx,127) : (int)max<long>(rx,-127);
+    int sy = (ry>0) ? (int)min<long>(ry,127) : (int)max<long>(ry,-127);
+    hidMove(sx, sy);
+    rx-=sx; ry-=sy;
+    hidWait(1);
+  }
+}
+inline void moveByPixels(int dpx, int dpy){
+  long dx = lroundf((float)dpx * countsPerPixel);
+  long dy = lroundf((float)dpy * countsPerPixel);
+  moveRelCounts(dx, dy);
+}
+inline void tapMoveFromHome(int px, int py){
+  phaseBegin(PH_HOME); homeCursor(); hidWait(8); phaseEnd();
+  phaseBegin(PH_MOVE); moveByPixels(px, py); phaseEnd();
+}
+
+uint8_t btnMaskFromName(const String& b){
+  String s=b; s.toLowerCase();
+  if(s=="right")  return MOUSE_RIGHT;
+  if(s=="middle") return MOUSE_MIDDLE;
+  return MOUSE_LEFT; // default
+}
+void pressBtn(const String& b){ hidPress(btnMaskFromName(b)); }
+void releaseBtn(const String& b){ hidRelease(btnMaskFromName(b)); }
+void clickBtn(const String& b, int holdMs=25){
+  uint8_t m=btnMaskFromName(b);
+  phaseBegin(PH_BUTTON); hidPress(m); hidWait(holdMs); hidRelease(m); phaseEnd();
+}
+
+void dragFromToBtn(int x1,int y1,int x2,int y2, const String& btn, int durMs, int stepsN){
+  if(stepsN < 1) stepsN = 1;
+  if(durMs < 0)  durMs = 0;
+
+  tapMoveFromHome(x1, y1);
+  phaseBegin(PH_BUTTON); hidWait(10); pressBtn(btn); hidWait(15); phaseEnd();
+
+  float cx = x1, cy = y1;
+  const float stepx = (x2 - x1) / float(stepsN);
+  const float stepy = (y2 - y1) / float(stepsN);
+  int lastX = x1, lastY = y1;
+  const int sleepPer = (durMs>0 ? max(1, durMs/stepsN) : 0);
+
+  phaseBegin(PH_MOVE);
+  for(int i=0;i<stepsN;i++){
+    cx += stepx; cy += stepy;
+    int ix = lroundf(cx);
+    int iy = lroundf(cy);
+    int dpx = ix - lastX;
+    int dpy = iy - lastY;
+    if(dpx!=0 || dpy!=0){
+      moveByPixels(dpx, dpy);
+      lastX = ix; lastY = iy;
+    }
+    if(sleepPer>0) hidWait(sleepPer);
+  }
+  phaseEnd();
+  phaseBegin(PH_BUTTON); hidWait(10); releaseBtn(btn); phaseEnd();
+}
+
+// ================= Gestos multi-touch =================
+// Passo "touch": text = contatos separados por ';', cada um com waypoints "x,y" ligados por '>'
+// (ex.: "800,600>800,300;900,600>900,300" = rolagem com dois dedos). Todos os contatos
+// percorrem o caminho em paralelo, no mesmo frame; um só ponto = toque parado (durMs = hold).
+static const int TOUCH_MAX_PTS = 8;
+struct TouchPath { uint8_t n; int16_t x[TOUCH_MAX_PTS], y[TOUCH_MAX_PTS]; };
+static const int TOUCH_FRAME_MS = 8;  // intervalo padrão entre frames
+
+// Retorna o nº de contatos (<= TOUCH_MAX) ou -1 se o texto não parsear.
+int touchParse(const char* s, TouchPath* out){
+  int nc = 0;
+  while(*s){
+    if(nc >= TOUCH_MAX) return -1;
+    TouchPath& p = out[nc]; p.n = 0;
+    while(*s && *s!=';'){
+      char* e;
+      long x = strtol(s, &e, 10);
+      if(e==s || *e!=',') return -1;
+      s = e+1;
+      long y = strtol(s, &e, 10);
+      if(e==s) return -1;
+      while(*e==' ') e++;
+      if(p.n >= TOUCH_MAX_PTS) return -1;
+      p.x[p.n] = (int16_t)x; p.y[p.n] = (int16_t)y; p.n++;
+      s = e;
+      if(*s=='>') s++;
+      else if(*s && *s!=';') return -1;
+    }
+    if(p.n) nc++;
+    if(*s==';') s++;
+  }
+  return nc;
+}
+
+// Ponto do contato no frame f de F: waypoints igualmente espaçados no tempo, aritmética inteira.
+void touchAt(const TouchPath& p, int f, int F, int& x, int& y){
+  if(p.n<2 || F<=0){ x=p.x[0]; y=p.y[0]; return; }
+  const long pos = (long)f * (p.n-1);
+  const int i = min<long>(pos / F, p.n-2);
+  const long r = pos - (long)i*F;
+  x = p.x[i] + (int)((p.x[i+1]-p.x[i]) * r / F);
+  y = p.y[i] + (int)((p.y[i+1]-p.y[i]) * r / F);
+}
+
+inline int16_t touchLogical(int px, int extent){
+  return (int16_t)constrain((long)px * TOUCH_LOGICAL_MAX / max(1, extent-1), 0L, (long)TOUCH_LOGICAL_MAX);
+}
+void touchSet(uint8_t slot, int px, int py, bool tip){
+  hidEmit(HidOp{OP_TOUCH, slot, touchLogical(px, screenW), touchLogical(py, screenH), (uint16_t)tip});
+}
+void touchFrame(uint8_t n){ hidEmit(HidOp{OP_TFRAME, n, 0, 0, 0}); }
+
+// Encosta todos os contatos, anda F frames (só emite report quando algo mudou) e levanta juntos.
+void touchGesture(const TouchPath* c, int nc, int durMs, int frames, int dx=0, int dy=0){
+  if(nc<=0) return;
+  bool moving = false;
+  for(int k=0;k<nc;k++) if(c[k].n > 1) moving = true;
+  if(!moving) frames = 1;
+  if(frames < 1) frames = 1;
+  const int per = max(0, durMs) / frames;
+  int lx[TOUCH_MAX], ly[TOUCH_MAX];
+
+  phaseBegin(PH_TOUCH);
+  for(int f=0; f<=frames; f++){
+    bool changed = (f==0);
+    for(int k=0;k<nc;k++){
+      int x, y; touchAt(c[k], f, frames, x, y); x += dx; y += dy;
+      if(f==0 || x!=lx[k] || y!=ly[k]){ touchSet(k, x, y, true); lx[k]=x; ly[k]=y; changed = true; }
+    }
+    if(changed) touchFrame(nc);
+    if(f<frames) hidWait(f==frames-1 ? durMs - per*(frames-1) : per);
+  }
+  for(int k=0;k<nc;k++) touchSet(k, lx[k], ly[k], false);
+  touchFrame(nc);
+  phaseEnd();
+}
+
+// ================= Scroll e consumer =================
+// Passo "scroll": y = roda vertical (>0 para cima), x = pan horizontal (>0 direita), ambos em
+// 1/120 de notch (120 = 1 notch). Sai em stepsN reports espaçados em durMs, sem mexer no cursor.
+void scrollBurst(long v, long h, int reports, int durMs){
+  if(!v && !h) return;
+  // um report carrega no máximo ±32767 unidades por eixo
+  const long need = (max(labs(v), labs(h)) + 32766) / 32767;
+  if(reports < need) reports = (int)need;
+  if(reports < 1) reports = 1;
+  const int per = (reports>1 && durMs>0) ? durMs / reports : 0;
+  long sv = 0, sh = 0;
+  phaseBegin(PH_SCROLL);
+  for(int i=1;i<=reports;i++){
+    const long tv = v * i / reports, th = h * i / reports;  // distribui sem perder unidades
+    hidEmit(HidOp{OP_WHEEL, 0, (int16_t)(th - sh), (int16_t)(tv - sv), 0});
+    sv = tv; sh = th;
+    if(i<reports && per) hidWait(per);
+  }
+  phaseEnd();
+}
+
+// Usages da página Consumer (HID Usage Tables, 0x0C); aceita também "0x00E9".
+uint16_t consumerUsage(const String& name){
+  String n=name; n.trim(); n.toLowerCase();
+  if(n.startsWith("0x")) return (uint16_t)strtoul(n.c_str()+2, nullptr, 16);
+  struct { const char* k; uint16_t u; } static const T[] = {
+    {"volup",0x00E9}, {"volume_up",0x00E9}, {"voldown",0x00EA}, {"volume_down",0x00EA}, {"mute",0x00E2},
+    {"play",0x00CD}, {"pause",0x00CD}, {"play_pause",0x00CD}, {"next",0x00B5}, {"prev",0x00B6},
+    {"previous",0x00B6}, {"stop",0x00B7}, {"eject",0x00B8},
+    {"bright_up",0x006F}, {"brightness_up",0x006F}, {"bright_down",0x0070}, {"brightness_down",0x0070},
+    {"mail",0x018A}, {"calculator",0x0192}, {"explorer",0x0194},
+    {"browser_search",0x0221}, {"browser_home",0x0223}, {"browser_back",0x0224},
+    {"browser_forward",0x0225}, {"browser_stop",0x0226}, {"browser_refresh",0x0227}, {"browser_bookmarks",0x022A},
+  };
+  for(const auto& e : T) if(n==e.k) return e.u;
+  return 0;
+}
+void consumerPress(uint16_t usage, int holdMs, int times){
+  if(!usage) return;
+  phaseBegin(PH_KEY);
+  for(int i=0;i<times;i++){
+    hidEmit(HidOp{OP_CPRESS, 0, (int16_t)usage, 0, 0});
+    hidWait(holdMs);
+    hidEmit(HidOp{OP_CRELEASE, 0, 0, 0, 0});
+    if(i<times-1) hidWait(holdMs);
+  }
+  phaseEnd();
+}
+
+// Passo que execStep pularia em silêncio (consumer sem usage, touch que não parseia): a API recusa
+// na entrada em vez de gravar um passo que só espera o delay. nullptr = ok.
+const char* stepInvalid(const Step& st){
+  if(st.type=="consumer" && !consumerUsage(st.text)) return "unknown consumer";
+  if(st.type=="touch"){ TouchPath c[TOUCH_MAX]; if(touchParse(st.text.c_str(), c) <= 0) return "bad touch"; }
+  return nullptr;
+}
+
+// ================= Jitter compilado =================
+// No início de cada loop os sorteios viram números inteiros por passo (stepJit).
+// Só o produtor usa o PRNG (xorshift32, sem float); a fila HID recebe valores prontos.
+struct StepJit {
+  int16_t  dx, dy, dx2, dy2;  // offset do alvo (px)
+  int32_t  dDelay;            // delta no delay pós-ação (ms)
+  uint16_t holdMs;            // 0 = padrão (25 ms)
+  uint32_t charSeed;          // 0 = cadência fixa (5 ms)
+};
+static const StepJit NO_JIT = {};
+static inline uint32_t xorshift32(uint32_t& s){ s ^= s<<13; s ^= s>>17; s ^= s<<5; return s; }
+int jitDraw(uint32_t& s, int lo, int hi){
+  if(hi<=lo) return lo;
+  uint32_t span = (uint32_t)(hi-lo) + 1;
+  if(jitter.dist==JD_TRI) return lo + (int)(((xorshift32(s)%span) + (xorshift32(s)%span)) / 2);
+  return lo + (int)(xorshift32(s)%span);
+}
+
+// Sorteia o jitter de um loop: mesma seed + mesmo índice de loop = mesmos números (também no dry-run).
+void jitCompile(const Step* p, int n, uint32_t loopIdx, StepJit* out){
+  uint32_t s = (jitter.seed*2654435761u) ^ ((loopIdx+1)*0x9E3779B9u);
+  if(!s) s = 1;
+  for(int i=0;i<n;i++){
+    const Step& st=p[i];
+    StepJit& j=out[i];
+    j = NO_JIT;
+    if(!jitter.on || st.jit==0) continue;
+    const int px = jitter.posPx;
+    const int pct = st.jit>0 ? min(st.jit, 100) : jitter.delayPct;
+    j.dx = jitDraw(s,-px,px);  j.dy = jitDraw(s,-px,px);
+    j.dx2= jitDraw(s,-px,px);  j.dy2= jitDraw(s,-px,px);
+    const int base = (st.delayMs>0? st.delayMs : actionDelay);  // = postDelay(st)
+    j.dDelay = (int32_t)((int64_t)base * jitDraw(s,-pct,pct) / 100);
+    j.holdMs = jitDraw(s, jitter.holdMin, jitter.holdMax);
+    j.charSeed = xorshift32(s) | 1;
+  }
+}
+
+void typeText(const String& s, uint32_t charSeed=0){
+  uint32_t r = charSeed;
+  for(size_t i=0;i<s.length();i++){
+    kbWrite((uint8_t)s[i]);
+    hidWait(r ? jitDraw(r, jitter.charMin, jitter.charMax) : 5);
+  }
+}
+
+uint8_t mapKeyName(const String& name){
+  String n=name; n.toLowerCase();
+  if(n=="return"||n=="enter") return KEY_RETURN;
+  if(n=="esc"||n=="escape") return KEY_ESC;
+  if(n=="tab") return KEY_TAB;
+  if(n=="space"||n=="spacebar") return ' ';
+  if(n=="backspace") return KEY_BACKSPACE;
+  if(n=="delete"||n=="del") return KEY_DELETE;
+  if(n=="up") return KEY_UP_ARROW;
+  if(n=="down") return KEY_DOWN_ARROW;
+  if(n=="left") return KEY_LEFT_ARROW;
+  if(n=="right") return KEY_RIGHT_ARROW;
+  return 0;
+}
+bool modOn(const String& s){ return s=="ctrl"||s=="control"||s=="alt"||s=="shift"||s=="gui"||s=="cmd"||s=="win"; }
+void holdMod(const String& m, bool press){
+  String s=m; s.toLowerCase();
+  if(s=="ctrl"||s=="control")  { if(press) kbPress(KEY_LEFT_CTRL); else kbRelease(KEY_LEFT_CTRL); }
+  else if(s=="alt")            { if(press) kbPress(KEY_LEFT_ALT);  else kbRelease(KEY_LEFT_ALT); }
+  else if(s=="shift")          { if(press) kbPress(KEY_LEFT_SHIFT);else kbRelease(KEY_LEFT_SHIFT); }
+  else if(s=="gui"||s=="cmd"||s=="win"){ if(press) kbPress(KEY_LEFT_GUI); else kbRelease(KEY_LEFT_GUI); }
+}
+void sendKeyCombo(const String& combo){
+  std::vector<String> parts;
+  int start=0; while(true){ int idx=combo.indexOf('+',start); if(idx<0){ parts.push_back(combo.substring(start)); break; } parts.push_back(combo.substring(start,idx)); start=idx+1; }
+  if(parts.empty()) return;
+  for(size_t i=0;i<parts.size();i++){ String p=parts[i]; p.trim(); p.toLowerCase(); if(modOn(p)) holdMod(p,true); }
+  String last=parts.back(); last.trim();
+  uint8_t code=mapKeyName(last);
+  if(code){ kbWrite(code); }
+  else {
+    String l=last; l.toLowerCase();
+    if(l=="f1") kbWrite(KEY_F1); else if(l=="f2") kbWrite(KEY_F2);
+    else if(l=="f3") kbWrite(KEY_F3); else if(l=="f4") kbWrite(KEY_F4);
+    else if(l=="f5") kbWrite(KEY_F5); else if(l=="f6") kbWrite(KEY_F6);
+    else if(l=="f7") kbWrite(KEY_F7); else if(l=="f8") kbWrite(KEY_F8);
+    else if(l=="f9") kbWrite(KEY_F9); else if(l=="f10") kbWrite(KEY_F10);
+    else if(l=="f11") kbWrite(KEY_F11); else if(l=="f12") kbWrite(KEY_F12);
+    else for(size_t i=0;i<last.length();i++) kbWrite((uint8_t)last[i]);
+  }
+  for(size_t i=0;i<parts.size();i++){ String p=parts[i]; p.trim(); p.toLowerCase(); if(modOn(p)) holdMod(p,false); }
+}
+
+static inline int postDelay(const Step& st){
+  // se delayMs do passo for 0, usa actionDelay global (1500ms)
+  return (st.delayMs>0? st.delayMs : actionDelay);
+}
+void postWait(int ms){ phaseBegin(PH_DELAY); hidWait(ms); phaseEnd(); }
+
+// Posição do cursor conhecida em tempo de execução: depois de um TAP o cursor está no alvo, então
+// outro TAP no mesmo ponto não precisa re-homar. Passos que não são neutros para o ponteiro
+// (drag, touch/pinch, tipos desconhecidos) esquecem a posição; runOnce esquece no início do loop.
+static bool cursorKnown = false;
+static int  cursorX = 0, cursorY = 0;
+inline void cursorForget(){ cursorKnown = false; }
+bool pointerNeutral(const String& t){
+  return t=="type" || t=="key" || t=="wait" || t=="scroll" || t=="consumer";
+}
+
+void execStep(const Step& st, const StepJit& j){
+  if(st.type!="tap" && !pointerNeutral(st.type)) cursorForget();
+
+  if(st.type=="tap"){
+    const int tx = st.x + j.dx, ty = st.y + j.dy;
+    if(!cursorKnown || cursorX!=tx || cursorY!=ty) tapMoveFromHome(tx, ty);
+    cursorKnown = true; cursorX = tx; cursorY = ty;
+    clickBtn(st.btn, j.holdMs ? j.holdMs : 25);
+    postWait(postDelay(st) + j.dDelay);
+
+  }else if(st.type=="drag"){
+    int dur = (st.durMs>0? st.durMs : 600);
+    int sn  = (st.stepsN>0? st.stepsN : 1);
+    dragFromToBtn(st.x + j.dx, st.y + j.dy, st.x2 + j.dx2, st.y2 + j.dy2, st.btn, dur, sn);
+    postWait(postDelay(st) + j.dDelay);
+
+  }else if(st.type=="type"){
+    phaseBegin(PH_TEXT); typeText(st.text, j.charSeed); phaseEnd();
+    postWait(postDelay(st) + j.dDelay);
+
+  }else if(st.type=="key"){
+    phaseBegin(PH_KEY); sendKeyCombo(st.text); phaseEnd();
+    postWait(postDelay(st) + j.dDelay);
+
+  }else if(st.type=="wait"){
+    postWait((st.delayMs>0? st.delayMs : actionDelay) + j.dDelay);
+
+  }else if(st.type=="touch" || st.type=="pinch"){
+    TouchPath c[TOUCH_MAX];
+    int nc;
+    if(st.type=="pinch"){
+      // dois dedos na horizontal em torno de (x,y): distância x2 -> y2 px (x2<y2 = zoom in)
+      nc = 2;
+      c[0] = TouchPath{2, {(int16_t)(st.x - st.x2/2), (int16_t)(st.x - st.y2/2)}, {(int16_t)st.y, (int16_t)st.y}};
+      c[1] = TouchPath{2, {(int16_t)(st.x + st.x2/2), (int16_t)(st.x + st.y2/2)}, {(int16_t)st.y, (int16_t)st.y}};
+    }else{
+      nc = touchParse(st.text.c_str(), c);
+    }
+    int dur = (st.durMs>0? st.durMs : 600);
+    int frames = (st.stepsN>1? st.stepsN : max(1, dur / TOUCH_FRAME_MS));
+    touchGesture(c, nc, dur, frames, j.dx, j.dy);
+    postWait(postDelay(st) + j.dDelay);
+
+  }else if(st.type=="scroll"){
+    scrollBurst(st.y, st.x, st.stepsN, st.durMs);
+    postWait(postDelay(st) + j.dDelay);
+
+  }else if(st.type=="consumer"){
+    consumerPress(consumerUsage(st.text), j.holdMs ? j.holdMs : 25, max(1, st.stepsN));
+    postWait(postDelay(st) + j.dDelay);
+  }
+}
+
+
+// ================= Otimizador de macro =================
+// Reescreve a lista num programa equivalente (mesmos reports HID nas mesmas posições, mesmos delays),
+// porém mais barato. Só grava o que continua valendo se a config mudar: delayMs==0 segue
+// significando actionDelay global, decidido na hora de rodar.
+//  - WAIT com delay explícito soma no delay explícito do passo anterior (mesmo jit)
+//  - TYPEs adjacentes viram um só quando o delay do primeiro é desprezível (<= TYPE_MERGE_GAP_MS,
+//    a cadência entre caracteres); vale o delay do último
+//  - DRAG com stepsN acima da distância em px é limitado (passos extras não geram report)
+// TAP repetido no mesmo ponto não re-homa, mas isso é decidido em execStep (cursorKnown).
+// Trabalha in-place e retorna o novo tamanho.
+static const int TYPE_MERGE_GAP_MS = 5;
+
+int optimizeSteps(Step* p, int n){
+  int out=0;
+  for(int i=0;i<n;i++){
+    Step st=p[i];
+    Step* prev = out>0 ? &p[out-1] : nullptr;
+
+    if(st.type=="wait"){
+      if(prev && prev->delayMs>0 && st.delayMs>0 && prev->jit==st.jit){ prev->delayMs += st.delayMs; continue; }
+    }else if(st.type=="type"){
+      if(prev && prev->type=="type" && prev->delayMs>0 && prev->delayMs<=TYPE_MERGE_GAP_MS){
+        prev->text += st.text; prev->delayMs = st.delayMs; prev->jit = st.jit; continue;
+      }
+    }else if(st.type=="drag"){
+      int dist = max(abs(st.x2-st.x), abs(st.y2-st.y));
+      if(st.stepsN > dist) st.stepsN = max(1, dist);
+    }
+    p[out++]=st;
+  }
+  return out;
+}
@@ -7,10 +7,21 @@
 #include <USBHID.h>
 #include <USBHIDMouse.h>
 #include <USBHIDKeyboard.h>
+#include <USBHIDConsumerControl.h>
 #include <HTTPClient.h>
 #include <ESPmDNS.h>
+#include <esp_timer.h>
+#include <esp_ota_ops.h>
+#include <Update.h>
 #include <math.h>
 #include <vector>
+#include <atomic>
+#include "hidq.h"
+#include "hid_desc.h"
+#include "macro.h"
+#include "cron.h"
+#include "trace.h"
+#include "runctl.h"
 
 #if defined(USE_NEOPIXEL)
   #include <Adafruit_NeoPixel.h>
@@ -20,10 +31,12 @@
 #endif
 
 // ================= Wi-Fi (STA) com IP fixo =================
+// IP/gateway ficam em Preferences, por placa (vazio = DHCP): o mesmo firmware vai por OTA para todas
+// as placas do fleet e não pode trazer um endereço compilado. Não entram no export/import.
 static const char* WIFI_SSID = "wifi-name";
 static const char* WIFI_PASS = "wifi-password";
-IPAddress local_IP(192, 168, 0, 44);
-IPAddress gateway(192, 168, 0, 1);
+String netIp = "192.168.0.44";
+String netGw = "192.168.0.1";
 IPAddress subnet(255, 255, 255, 0);
 IPAddress dns1(8, 8, 8, 8), dns2(1, 1, 1, 1);
 
@@ -32,21 +45,50 @@ USBHID HID;
 USBHIDMouse Mouse;
 USBHIDKeyboard Keyboard;
 
+// Descritores e layout dos reports de toque/roda em hid_desc.h.
+class TouchDigitizer : public USBHIDDevice {
+public:
+  TouchDigitizer(){
+    static bool added = false;
+    if(!added){ added = true; HID.addDevice(this, sizeof(touchDesc)); }
+  }
+  uint16_t _onGetDescriptor(uint8_t* buf) override { memcpy(buf, touchDesc, sizeof(touchDesc)); return sizeof(touchDesc); }
+  uint16_t _onGetFeature(uint8_t id, uint8_t* buf, uint16_t len) override {
+    if(id!=HID_REPORT_ID_TOUCH_MAX || len<1) return 0;
+    buf[0] = TOUCH_MAX; return 1;
+  }
+  bool send(const TouchReport& r){ return HID.SendReport(HID_REPORT_ID_TOUCH, &r, sizeof(r)); }
+};
+TouchDigitizer Touch;
+
+class HiResWheel : public USBHIDDevice {
+public:
+  volatile uint8_t mult = 0;  // bit0 = roda, bit2 = pan (escrito pelo host)
+  HiResWheel(){
+    static bool added = false;
+    if(!added){ added = true; HID.addDevice(this, sizeof(wheelDesc)); }
+  }
+  uint16_t _onGetDescriptor(uint8_t* buf) override { memcpy(buf, wheelDesc, sizeof(wheelDesc)); return sizeof(wheelDesc); }
+  uint16_t _onGetFeature(uint8_t id, uint8_t* buf, uint16_t len) override {
+    if(id!=HID_REPORT_ID_WHEEL_MULT || len<1) return 0;
+    buf[0] = mult; return 1;
+  }
+  void _onSetFeature(uint8_t id, const uint8_t* buf, uint16_t len) override {
+    if(id==HID_REPORT_ID_WHEEL_MULT && len>=1) mult = buf[0] & 0x05;
+  }
+  bool hiResV() const { return mult & 0x01; }
+  bool hiResH() const { return mult & 0x04; }
+  bool send(int16_t wheel, int16_t pan){ WheelReport r{wheel, pan}; return HID.SendReport(HID_REPORT_ID_WHEEL, &r, sizeof(r)); }
+};
+HiResWheel Wheel;
+USBHIDConsumerControl Consumer;
+
 // ================= Web / Store =================
 WebServer server(80);
 Preferences prefs;
 
-// ================= Modelo de passos =================
-// type: "tap" | "drag" | "type" | "key" | "wait"
-struct Step {
-  String type;
-  int x=0, y=0, x2=0, y2=0;
-  String text;        // para type/key
-  String btn="left";  // "left" | "right" | "middle"
-  int delayMs=0;      // delay POS-ação (se 0, usa actionDelay global)
-  int durMs=0;        // duração do DRAG (ms)
-  int stepsN=1;       // passos do DRAG (interpolação)
-};
+// ================= Macro carregada =================
+// (modelo de passos, emissão de ops e otimizador em macro.h)
 static const int MAX_STEPS = 160;
 static Step steps[MAX_STEPS];
 static int stepCount = 0;
@@ -57,16 +99,26 @@ int   screenH = 1080;
 float countsPerPixel = 5.0f; // comece alto; depois calibre
 int   actionDelay = 1500;    // ✅ Delay padrão global (ms)
 bool  autoRunOnBoot = false;
+bool  autoOptimize = false;  // otimiza a macro ao importar/enviar
+
+// Jitter "humanizado", determinístico por seed (JitterCfg em macro.h)
+JitterCfg jitter;
 
 String pcHost = "127.0.0.1";
 int    pcPort = 5005;
 
+// Agendador (JSON aceito por /sched; compilado em schedParse)
+String schedJson = "{\"tz\":\"UTC0\",\"entries\":[]}";
+String schedTz = "UTC0";
+
 // Execução/estado
 TaskHandle_t runnerTask = nullptr;
 volatile bool wantStop = false;
 volatile bool runningLoop = false;
 volatile int  runStepIndex = 0;
 volatile long loopsRemaining = 0;  // >0 = contador; 0 = parar; -1 = infinito
+volatile int64_t startAtUs = 0;    // início armado (esp_timer, µs); 0 = imediato
+char deviceId[24] = "autoclicker";   // instância mDNS/TXT "id" e /status; o host é sempre autoclicker.local
 
 // ================= LED helpers =================
 void ledSet(uint8_t r, uint8_t g, uint8_t b){
@@ -83,6 +135,50 @@ void ledStandby(){ ledSet(0, 0, 180); }   // azul
 void ledRunning(){ ledSet(0, 180, 0); }   // verde
 void ledStopped(){ ledSet(180, 0, 0); }   // vermelho
 
+// ================= Step <-> JSON =================
+Step stepFromJson(JsonObject o){
+  Step st;
+  st.type   = (const char*)(o["type"] | "");
+  st.x      = o["x"]   | 0;
+  st.y      = o["y"]   | 0;
+  st.x2     = o["x2"]  | 0;
+  st.y2     = o["y2"]  | 0;
+  st.text   = (const char*)(o["text"] | "");
+  st.btn    = (const char*)(o["btn"]  | (const char*)(o["button"] | "left"));
+  st.delayMs= o["delayMs"] | (o["ms"] | 0);
+  st.durMs  = o["durMs"]   | 600;
+  st.stepsN = o["stepsN"]  | 1;
+  st.jit    = o["jit"]     | -1;
+  if(st.stepsN < 1) st.stepsN = 1;
+  return st;
+}
+void stepToJson(JsonObject o, const Step& st){
+  o["type"]=st.type; o["x"]=st.x; o["y"]=st.y; o["x2"]=st.x2; o["y2"]=st.y2;
+  o["text"]=st.text; o["btn"]=st.btn;
+  o["delayMs"]=st.delayMs; o["durMs"]=st.durMs; o["stepsN"]=st.stepsN;
+  o["jit"]=st.jit;
+}
+
+void jitterFromJson(JsonObject o){
+  jitter.on       = o["on"]       | jitter.on;
+  jitter.seed     = o["seed"]     | jitter.seed;
+  jitter.dist     = String((const char*)(o["dist"] | (jitter.dist==JD_TRI ? "tri" : "uniform")))=="tri" ? JD_TRI : JD_UNIFORM;
+  jitter.delayPct = constrain((int)(o["delayPct"] | jitter.delayPct), 0, 100);
+  jitter.holdMin  = o["hold"][0]  | jitter.holdMin;
+  jitter.holdMax  = o["hold"][1]  | jitter.holdMax;
+  jitter.charMin  = o["char"][0]  | jitter.charMin;
+  jitter.charMax  = o["char"][1]  | jitter.charMax;
+  jitter.posPx    = constrain((int)(o["posPx"] | jitter.posPx), 0, 100);
+  jitter.holdMin  = constrain(jitter.holdMin, 1, 1000); jitter.holdMax = constrain(jitter.holdMax, jitter.holdMin, 1000);
+  jitter.charMin  = constrain(jitter.charMin, 0, 1000); jitter.charMax = constrain(jitter.charMax, jitter.charMin, 1000);
+}
+void jitterToJson(JsonObject o){
+  o["on"]=jitter.on; o["seed"]=jitter.seed; o["dist"]= jitter.dist==JD_TRI ? "tri" : "uniform";
+  o["delayPct"]=jitter.delayPct; o["posPx"]=jitter.posPx;
+  JsonArray h=o.createNestedArray("hold"); h.add(jitter.holdMin); h.add(jitter.holdMax);
+  JsonArray c=o.createNestedArray("char"); c.add(jitter.charMin); c.add(jitter.charMax);
+}
+
 // ================= Persistência =================
 void persistAll(){
   prefs.begin("cfg", false);
@@ -91,18 +187,20 @@ void persistAll(){
   prefs.putFloat("cpp", countsPerPixel);
   prefs.putInt("delay", actionDelay);
   prefs.putBool("autorun", autoRunOnBoot);
+  prefs.putBool("autoopt", autoOptimize);
+  prefs.putString("sched", schedJson);
+  {
+    DynamicJsonDocument j(256); jitterToJson(j.to<JsonObject>());
+    String js; serializeJson(j, js); prefs.putString("jitter", js);
+  }
   prefs.putString("pchost", pcHost);
   prefs.putInt("pcport", pcPort);
+  prefs.putString("ip", netIp);
+  prefs.putString("gw", netGw);
 
   DynamicJsonDocument doc(32768);
   JsonArray arr = doc.createNestedArray("steps");
-  for(int i=0;i<stepCount;i++){
-    JsonObject o = arr.createNestedObject();
-    o["type"]=steps[i].type;
-    o["x"]=steps[i].x; o["y"]=steps[i].y; o["x2"]=steps[i].x2; o["y2"]=steps[i].y2;
-    o["text"]=steps[i].text; o["btn"]=steps[i].btn;
-    o["delayMs"]=steps[i].delayMs; o["durMs"]=steps[i].durMs; o["stepsN"]=steps[i].stepsN;
-  }
+  for(int i=0;i<stepCount;i++) stepToJson(arr.createNestedObject(), steps[i]);
   String s; serializeJson(doc, s);
   prefs.putString("macro", s);
   prefs.end();
@@ -115,27 +213,28 @@ void loadAll(){
   countsPerPixel = prefs.getFloat("cpp", 5.0f);
   actionDelay = prefs.getInt("delay", 1500); // ✅ 1500 padrão
   autoRunOnBoot = prefs.getBool("autorun", false);
+  autoOptimize = prefs.getBool("autoopt", false);
   pcHost = prefs.getString("pchost", "127.0.0.1");
   pcPort = prefs.getInt("pcport", 5005);
+  netIp = prefs.getString("ip", netIp);
+  netGw = prefs.getString("gw", netGw);
   String s = prefs.getString("macro", "");
+  schedJson = prefs.getString("sched", schedJson);
+  String js = prefs.getString("jitter", "");
   prefs.end();
 
+  if(js.length()){
+    DynamicJsonDocument j(256);
+    if(deserializeJson(j, js)==DeserializationError::Ok) jitterFromJson(j.as<JsonObject>());
+  }
+
   stepCount = 0;
   if(s.length()){
     DynamicJsonDocument doc(32768);
     if(deserializeJson(doc, s)==DeserializationError::Ok){
       for(JsonObject o : doc["steps"].as<JsonArray>()){
         if(stepCount>=MAX_STEPS) break;
-        Step st;
-        st.type = (const char*)o["type"];
-        st.x=o["x"]|0; st.y=o["y"]|0; st.x2=o["x2"]|0; st.y2=o["y2"]|0;
-        st.text=(const char*)(o["text"]|"");
-        st.btn = (const char*)(o["btn"] | (const char*)(o["button"] | "left"));
-        st.delayMs = o["delayMs"] | (o["ms"] | 0);
-        st.durMs   = o["durMs"]   | 600;
-        st.stepsN  = o["stepsN"]  | 1;
-        if(st.stepsN < 1) st.stepsN = 1;
-        steps[stepCount++]=st;
+        steps[stepCount++]=stepFromJson(o);
       }
     }
   }
@@ -152,162 +251,278 @@ void sendJSON(int code, const String& body){
   server.send(code, "application/json; charset=utf-8", body);
 }
 void okJSON(){ sendJSON(200, "{\"ok\":true}"); }
+void errJSON(int code, const String& err){
+  DynamicJsonDocument d(256); d["error"]=err;
+  String s; serializeJson(d,s); sendJSON(code,s);
+}
+// Recusa a lista inteira no primeiro passo inválido (stepInvalid): "step N: <motivo>".
+bool stepsValid(const std::vector<Step>& v){
+  for(size_t i=0;i<v.size();i++)
+    if(const char* e = stepInvalid(v[i])){ errJSON(400, String("step ") + (int)(i+1) + ": " + e); return false; }
+  return true;
+}
 void handleOptions(){ sendCORS(); server.send(204); }
 
-// ================= HID helpers =================
-void homeCursor(){
-  for(int i=0;i<30;i++){ Mouse.move(-127,-127); delay(1); }
-}
-void moveRelCounts(long dx, long dy){
-  long rx=dx, ry=dy;
-  while(rx!=0 || ry!=0){
-    int sx = (rx>0) ? (int)min<long>(rx,127) : (int)max<long>(rx,-127);
-    int sy = (ry>0) ? (int)min<long>(ry,127) : (int)max<long>(ry,-127);
-    Mouse.move(sx, sy);
-    rx-=sx; ry-=sy;
-    delay(1);
-  }
-}
-inline void moveByPixels(int dpx, int dpy){
-  long dx = lroundf((float)dpx * countsPerPixel);
-  long dy = lroundf((float)dpy * countsPerPixel);
-  moveRelCounts(dx, dy);
-}
-inline void tapMoveFromHome(int px, int py){
-  homeCursor(); delay(8);
-  moveByPixels(px, py);
-}
-
-uint8_t btnMaskFromName(const String& b){
-  String s=b; s.toLowerCase();
-  if(s=="right")  return MOUSE_RIGHT;
-  if(s=="middle") return MOUSE_MIDDLE;
-  return MOUSE_LEFT; // default
-}
-void pressBtn(const String& b){ Mouse.press(btnMaskFromName(b)); }
-void releaseBtn(const String& b){ Mouse.release(btnMaskFromName(b)); }
-void clickBtn(const String& b){ uint8_t m=btnMaskFromName(b); Mouse.press(m); delay(25); Mouse.release(m); }
-
-void dragFromToBtn(int x1,int y1,int x2,int y2, const String& btn, int durMs, int stepsN){
-  if(stepsN < 1) stepsN = 1;
-  if(durMs < 0)  durMs = 0;
-
-  tapMoveFromHome(x1, y1); delay(10);
-  pressBtn(btn); delay(15);
-
-  float cx = x1, cy = y1;
-  const float stepx = (x2 - x1) / float(stepsN);
-  const float stepy = (y2 - y1) / float(stepsN);
-  int lastX = x1, lastY = y1;
-  const int sleepPer = (durMs>0 ? max(1, durMs/stepsN) : 0);
-
-  for(int i=0;i<stepsN;i++){
-    cx += stepx; cy += stepy;
-    int ix = lroundf(cx);
-    int iy = lroundf(cy);
-    int dpx = ix - lastX;
-    int dpy = iy - lastY;
-    if(dpx!=0 || dpy!=0){
-      moveByPixels(dpx, dpy);
-      lastX = ix; lastY = iy;
+// ================= Timeline (profiler) =================
+// Ring de eventos e acumuladores do último loop em trace.h; aqui só o lock e o relógio.
+// Em dry-run o relógio é virtual: os delays só avançam o tempo e nada sai pelo HID.
+static const int TRACE_CAP = 512;
+static TraceLog<TRACE_CAP, MAX_STEPS> trace;
+static portMUX_TYPE traceMux = portMUX_INITIALIZER_UNLOCKED;
+
+volatile bool dryRun = false;
+static uint64_t dryClockUs = 0;
+
+static inline uint64_t nowUs(){ return dryRun ? dryClockUs : (uint64_t)esp_timer_get_time(); }
+
+void tracePhase(const HidOp& o){
+  const uint64_t t = nowUs();
+  portENTER_CRITICAL(&traceMux);
+  trace.phase(o, (uint16_t)runStepIndex, t);
+  portEXIT_CRITICAL(&traceMux);
+}
+void traceRunBegin(){ portENTER_CRITICAL(&traceMux); trace.runBegin(); portEXIT_CRITICAL(&traceMux); }
+bool traceGet(uint32_t idx, TraceEv& out){
+  portENTER_CRITICAL(&traceMux);
+  bool ok = trace.get(idx, out);
+  portEXIT_CRITICAL(&traceMux);
+  return ok;
+}
+void traceClear(){ portENTER_CRITICAL(&traceMux); trace.clear(); portEXIT_CRITICAL(&traceMux); }
+
+// ================= Fila de reports HID (SPSC) =================
+// O interpretador (produtor) traduz os passos em ops e enche a fila à frente;
+// a task hidPump (consumidor, prioridade alta) drena no ritmo do polling USB.
+// Cada op gera no máximo um report HID; WAIT/PHASE/STEP só marcam tempo e progresso.
+// Em dry-run não há fila: as ops rodam inline contra o relógio virtual.
+static const uint32_t HIDQ_CAP = 256;      // potência de 2
+static const uint32_t HIDQ_PREFILL = 32;   // ops acumuladas antes de começar a drenar
+static HidRing<HIDQ_CAP, HIDQ_PREFILL> hidQ;
+TaskHandle_t hidPumpTask = nullptr;
+TaskHandle_t hidProducer = nullptr;  // quem dorme com a fila cheia (runner)
+SemaphoreHandle_t hidSyncSem = nullptr;
+static TouchReport touchRep = {};  // só o consumidor mexe
+static int wheelAccV = 0, wheelAccH = 0;  // resto em unidades quando o host está em notches
+
+// Espera interrompível: acorda cedo se pedirem stop.
+void waitMs(int ms){
+  if(ms<=0) return;
+  if(dryRun){ dryClockUs += (uint64_t)ms*1000ULL; return; }
+  const uint64_t end = nowUs() + (uint64_t)ms*1000ULL;
+  while(!wantStop){
+    uint64_t t = nowUs();
+    if(t >= end) break;
+    ulTaskNotifyTake(pdTRUE, max<TickType_t>(1, pdMS_TO_TICKS((end - t)/1000)));
+  }
+}
+
+void hidExec(const HidOp& o){
+  switch(o.op){
+    case OP_MOVE:     if(!dryRun) Mouse.move(o.x, o.y); break;
+    case OP_PRESS:    if(!dryRun) Mouse.press(o.a); break;
+    case OP_RELEASE:  if(!dryRun) Mouse.release(o.a); break;
+    case OP_KPRESS:   if(!dryRun) Keyboard.press(o.a); break;
+    case OP_KRELEASE: if(!dryRun) Keyboard.release(o.a); break;
+    case OP_WAIT:     waitMs(o.ms); break;
+    case OP_PHASE:
+      tracePhase(o);
+      break;
+    case OP_STEP:     runStepIndex = o.x; break;
+    case OP_SYNC:     xSemaphoreGive(hidSyncSem); break;
+    case OP_TOUCH:    touchRep.c[o.a] = TouchContact{(uint8_t)(o.ms & 1), o.a, (uint16_t)o.x, (uint16_t)o.y}; break;
+    case OP_TFRAME:   touchRep.count = o.a; if(!dryRun) Touch.send(touchRep); break;
+    case OP_WHEEL:
+      if(!dryRun){
+        int16_t v = wheelUnits(o.y, Wheel.hiResV(), wheelAccV), h = wheelUnits(o.x, Wheel.hiResH(), wheelAccH);
+        if(v || h) Wheel.send(v, h);
+      }
+      break;
+    case OP_CPRESS:   if(!dryRun) Consumer.press((uint16_t)o.x); break;
+    case OP_CRELEASE: if(!dryRun) Consumer.release(); break;
+  }
+}
+
+inline uint32_t hidQDepth(){ return hidQ.depth(); }
+inline void hidKick(){ if(hidQ.consIdle.load()) xTaskNotifyGive(hidPumpTask); }
+
+// Fila cheia: o produtor dorme até a hidPump liberar meia fila (notificação), sem polling por tick.
+// O timeout só cobre uma notificação perdida; stop também acorda o runner.
+void hidPush(const HidOp& o){
+  if(wantStop && o.op!=OP_SYNC) return;  // o consumidor vai descartar tudo mesmo
+  while(!hidQ.push(o)){
+    if(wantStop && o.op!=OP_SYNC) return;
+    hidProducer = xTaskGetCurrentTaskHandle();
+    hidQ.prodWaiting = true;
+    hidQ.primed = true; hidKick();
+    // re-checa depois de marcar: se a pump liberou espaço antes de ver a flag, não dorme
+    if(!hidQ.full()){ hidQ.prodWaiting = false; continue; }
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+    hidQ.prodWaiting = false;
+  }
+  if(hidQ.primed.load()) hidKick();
+}
+void hidEmit(const HidOp& o){ if(dryRun) hidExec(o); else hidPush(o); }
+
+// Abre/fecha um stream de reports. hidSync() bloqueia até o consumidor executar tudo (ou descartar no stop).
+void hidBegin(){ if(dryRun) return; hidQ.begin(); }
+void hidSync(){
+  if(dryRun) return;
+  hidQ.end();
+  HidOp o{OP_SYNC,0,0,0,0};
+  hidPush(o);
+  xTaskNotifyGive(hidPumpTask);
+  xSemaphoreTake(hidSyncSem, portMAX_DELAY);
+}
+
+// Descarta a fila (stop) e solta botões/teclas que tenham ficado pressionados.
+void hidDiscard(){
+  if(!hidQ.depth()) return;
+  hidQ.drain([](const HidOp& o){ if(o.op==OP_SYNC) xSemaphoreGive(hidSyncSem); });
+  if(hidQ.wakeProducer() && hidProducer) xTaskNotifyGive(hidProducer);
+  Mouse.release(MOUSE_LEFT | MOUSE_RIGHT | MOUSE_MIDDLE);
+  Keyboard.releaseAll();
+  Consumer.release();
+  if(touchRep.count){  // levanta os dedos que ficaram na tela
+    for(int i=0;i<touchRep.count;i++) touchRep.c[i].tip = 0;
+    Touch.send(touchRep); touchRep.count = 0;
+  }
+}
+
+void hidPump(void*){
+  while(true){
+    if(wantStop) hidDiscard();
+    HidOp o;
+    if(!hidQ.pop(o)){
+      hidQ.consIdle = true;
+      // re-checa depois de marcar idle: um push entre as duas leituras já deixou a notificação pendente
+      if(hidQ.primed.load() && hidQ.depth()){ hidQ.consIdle = false; continue; }
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+      hidQ.consIdle = false;
+      continue;
     }
-    if(sleepPer>0) delay(sleepPer);
-  }
-  delay(10); releaseBtn(btn);
-}
-
-void typeText(const String& s){
-  for(size_t i=0;i<s.length();i++){ Keyboard.print(s.substring(i,i+1)); delay(5); }
-}
-
-uint8_t mapKeyName(const String& name){
-  String n=name; n.toLowerCase();
-  if(n=="return"||n=="enter") return KEY_RETURN;
-  if(n=="esc"||n=="escape") return KEY_ESC;
-  if(n=="tab") return KEY_TAB;
-  if(n=="space"||n=="spacebar") return ' ';
-  if(n=="backspace") return KEY_BACKSPACE;
-  if(n=="delete"||n=="del") return KEY_DELETE;
-  if(n=="up") return KEY_UP_ARROW;
-  if(n=="down") return KEY_DOWN_ARROW;
-  if(n=="left") return KEY_LEFT_ARROW;
-  if(n=="right") return KEY_RIGHT_ARROW;
-  return 0;
-}
-bool modOn(const String& s){ return s=="ctrl"||s=="control"||s=="alt"||s=="shift"||s=="gui"||s=="cmd"||s=="win"; }
-void holdMod(const String& m, bool press){
-  String s=m; s.toLowerCase();
-  if(s=="ctrl"||s=="control")  { if(press) Keyboard.press(KEY_LEFT_CTRL); else Keyboard.release(KEY_LEFT_CTRL); }
-  else if(s=="alt")            { if(press) Keyboard.press(KEY_LEFT_ALT);  else Keyboard.release(KEY_LEFT_ALT); }
-  else if(s=="shift")          { if(press) Keyboard.press(KEY_LEFT_SHIFT);else Keyboard.release(KEY_LEFT_SHIFT); }
-  else if(s=="gui"||s=="cmd"||s=="win"){ if(press) Keyboard.press(KEY_LEFT_GUI); else Keyboard.release(KEY_LEFT_GUI); }
-}
-void sendKeyCombo(const String& combo){
-  std::vector<String> parts;
-  int start=0; while(true){ int idx=combo.indexOf('+',start); if(idx<0){ parts.push_back(combo.substring(start)); break; } parts.push_back(combo.substring(start,idx)); start=idx+1; }
-  if(parts.empty()) return;
-  for(size_t i=0;i<parts.size();i++){ String p=parts[i]; p.trim(); p.toLowerCase(); if(modOn(p)) holdMod(p,true); }
-  String last=parts.back(); last.trim();
-  uint8_t code=mapKeyName(last);
-  if(code){ Keyboard.write(code); }
-  else {
-    String l=last; l.toLowerCase();
-    if(l=="f1") Keyboard.write(KEY_F1); else if(l=="f2") Keyboard.write(KEY_F2);
-    else if(l=="f3") Keyboard.write(KEY_F3); else if(l=="f4") Keyboard.write(KEY_F4);
-    else if(l=="f5") Keyboard.write(KEY_F5); else if(l=="f6") Keyboard.write(KEY_F6);
-    else if(l=="f7") Keyboard.write(KEY_F7); else if(l=="f8") Keyboard.write(KEY_F8);
-    else if(l=="f9") Keyboard.write(KEY_F9); else if(l=="f10") Keyboard.write(KEY_F10);
-    else if(l=="f11") Keyboard.write(KEY_F11); else if(l=="f12") Keyboard.write(KEY_F12);
-    else Keyboard.print(last);
-  }
-  for(size_t i=0;i<parts.size();i++){ String p=parts[i]; p.trim(); p.toLowerCase(); if(modOn(p)) holdMod(p,false); }
-}
-
-static inline int postDelay(const Step& st){
-  // se delayMs do passo for 0, usa actionDelay global (1500ms)
-  return (st.delayMs>0? st.delayMs : actionDelay);
+    if(hidQ.wakeProducer() && hidProducer) xTaskNotifyGive(hidProducer);
+    hidExec(o);
+  }
+}
+
+// ================= Jitter compilado (por loop) =================
+// jitCompile em macro.h; o runner recompila no início de cada loop.
+static StepJit stepJit[MAX_STEPS];
+static uint32_t jitLoop = 0;  // loop atual desde o startRun (seed por loop)
+
+volatile bool runBusy = false;  // há um runOnce produzindo (runner) ou um dry-run/estimativa em curso
+static portMUX_TYPE runMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Quem usa o HID fora do runner (dry-run/estimativa, /hidTest; todos na loop task) reserva runBusy
+// junto com o teste, sob o mesmo lock que o schedLaunch (outra task) usa para armar uma execução real.
+bool runReserve(){
+  portENTER_CRITICAL(&runMux);
+  bool ok = !runningLoop && !runBusy;
+  if(ok) runBusy=true;
+  portEXIT_CRITICAL(&runMux);
+  return ok;
+}
+// Dry-run/estimativa usam o mesmo caminho de HID com dryRun global.
+bool dryBegin(){
+  if(!runReserve()) return false;
+  dryRun=true;
+  return true;
 }
+void dryEnd(){ dryRun=false; runBusy=false; }
 
 void runOnce(){
   ledRunning();
   wantStop = false;
   runStepIndex = 0;
+  traceRunBegin();
+  cursorForget();
+  jitCompile(steps, stepCount, jitLoop++, stepJit);
+  hidBegin();
 
-  Mouse.move(1,0); delay(5); Mouse.move(-1,0); delay(5);
+  phaseBegin(PH_START);
+  hidMove(1,0); hidWait(5); hidMove(-1,0); hidWait(5);
+  phaseEnd();
 
   for(int i=0;i<stepCount;i++){
-    if(wantStop){ ledStopped(); return; }
-    runStepIndex = i+1;
-    const Step& st=steps[i];
+    if(wantStop) break;
+    hidStep(i+1);
+    execStep(steps[i], stepJit[i]);
+  }
+  hidSync();  // espera o consumidor terminar (ou descartar no stop)
+  if(wantStop){ ledStopped(); return; }
+  ledStandby();
+}
 
-    if(st.type=="tap"){
-      tapMoveFromHome(st.x, st.y);
-      clickBtn(st.btn);
-      delay(postDelay(st));
+// ================= Otimizador de macro =================
+// Custo de um loop via dry-run (relógio virtual, sem HID e sem trace). Chamar entre dryBegin/dryEnd.
+uint64_t estimateLoopUs(const Step* p, int n){
+  bool tr=trace.on; trace.on=false;
+  dryClockUs=0;
+  cursorForget();
+  for(int i=0;i<n;i++) execStep(p[i], NO_JIT);
+  trace.on=tr;
+  return dryClockUs;
+}
 
-    }else if(st.type=="drag"){
-      int dur = (st.durMs>0? st.durMs : 600);
-      int sn  = (st.stepsN>0? st.stepsN : 1);
-      dragFromToBtn(st.x,st.y,st.x2,st.y2, st.btn, dur, sn);
-      delay(postDelay(st));
+// ================= Macro/firmware pendentes =================
+// Deltas de macro e OTA chegam enquanto a macro roda; a troca acontece entre loops.
+static Step stagedSteps[MAX_STEPS];
+static int  stagedCount = 0;
+volatile bool macroPending = false;
+volatile bool pendingReboot = false;
+SemaphoreHandle_t macroMutex = nullptr;
+
+void applyStagedMacro(){
+  xSemaphoreTake(macroMutex, portMAX_DELAY);
+  if(macroPending){
+    for(int i=0;i<stagedCount;i++) steps[i]=stagedSteps[i];
+    stepCount=stagedCount;
+    macroPending=false;
+    persistAll();
+  }
+  xSemaphoreGive(macroMutex);
+}
 
-    }else if(st.type=="type"){
-      typeText(st.text); delay(postDelay(st));
+// Aplica a pendente já se o runner estiver livre (reservado para não começar um loop no meio da cópia).
+bool applyStagedIfIdle(){
+  if(!runReserve()) return false;
+  applyStagedMacro(); runBusy=false;
+  return true;
+}
 
-    }else if(st.type=="key"){
-      sendKeyCombo(st.text); delay(postDelay(st));
+// Cópia da macro efetiva (a pendente, se houver): base de toda edição e do que a UI/API mostram.
+std::vector<Step> macroEffective(){
+  xSemaphoreTake(macroMutex, portMAX_DELAY);
+  std::vector<Step> v = macroPending ? std::vector<Step>(stagedSteps, stagedSteps+stagedCount)
+                                     : std::vector<Step>(steps, steps+stepCount);
+  xSemaphoreGive(macroMutex);
+  return v;
+}
 
-    }else if(st.type=="wait"){
-      delay(st.delayMs>0? st.delayMs : actionDelay);
-    }
-  }
-  ledStandby();
+// Toda escrita da macro (UI, /steps/*, /import, /optimize) vira a macro pendente, substituindo um delta
+// pendente mais antigo; com o runner livre aplica já, senão no fim do loop corrente. true = aplicada.
+bool macroCommit(const std::vector<Step>& v){
+  xSemaphoreTake(macroMutex, portMAX_DELAY);
+  const int n = min((int)v.size(), MAX_STEPS);
+  for(int i=0;i<n;i++) stagedSteps[i]=v[i];
+  stagedCount=n; macroPending=true;
+  xSemaphoreGive(macroMutex);
+  return applyStagedIfIdle();
 }
 
 void runner(void*){
   while(true){
+    if(runningLoop && startAtUs){
+      // início sincronizado (fleet): dorme até ~ARM_SPIN_US antes e gira o resto
+      uint32_t ms = armSleepMs(startAtUs, esp_timer_get_time());
+      if(ms){ ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ms)); continue; }
+      while(esp_timer_get_time() < startAtUs) {}
+      startAtUs = 0;
+    }
     if(runningLoop){
-      runOnce();
+      runBusy=true; runOnce(); runBusy=false;
+      // fronteira de loop: aplica a macro nova (delta); firmware novo reinicia e retoma os loops restantes
+      if(macroPending) applyStagedMacro();
       if(!runningLoop) { vTaskDelay(pdMS_TO_TICKS(20)); continue; }
       if(loopsRemaining > 0){
         loopsRemaining--;
@@ -316,10 +531,188 @@ void runner(void*){
           ledStandby();
         }
       }
+      if(pendingReboot && runningLoop){
+        prefs.begin("cfg", false); prefs.putInt("resume", (int)loopsRemaining); prefs.end();
+        runningLoop = false;
+        continue;
+      }
       for(int i=0;i<10 && runningLoop && !wantStop;i++) vTaskDelay(pdMS_TO_TICKS(20));
     }else{
-      vTaskDelay(pdMS_TO_TICKS(50));
+      // ocioso: dorme até startRun() notificar (sem polling)
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+  }
+}
+
+// n>0 = N loops; n<=0 = infinito; atUs>0 = começa nesse instante do esp_timer
+void startRun(long n, int64_t atUs = 0){
+  startAtUs = atUs;
+  jitLoop = 0;
+  loopsRemaining = (n>0 ? n : -1);
+  wantStop=false; runningLoop=true; ledRunning();
+  if(runnerTask) xTaskNotifyGive(runnerTask);
+}
+
+// ================= Agendador =================
+// Entradas disparam a macro com N loops:
+//   cron  -> "m h dom mon dow" (lista, faixa, */passo; dow 0-7, 0/7 = domingo), hora local via SNTP
+//   in    -> "segundos" após boot/config (dispara uma vez)
+//   gpio  -> "pino:rising|falling" (ISR notifica a task, debounce 200 ms; pinos reservados: schedPinOk)
+//   event -> "nome", via POST /event?name=... ou linha "event nome" no CDC
+// A task mantém uma fila de timers ordenada por prazo e dorme até o primeiro (ou até um aviso).
+static const int MAX_SCHED = 8;
+static const uint32_t SCHED_RELOAD = 1UL<<31;   // bits 0..MAX_SCHED-1 = entrada disparada por GPIO/evento
+static SchedEntry schedEnt[MAX_SCHED];          // cópia da task
+static int        schedCount = 0;
+static SchedEntry schedCfg[MAX_SCHED];          // cópia do lado HTTP/loop
+static int        schedCfgCount = 0;
+static portMUX_TYPE schedMux = portMUX_INITIALIZER_UNLOCKED;
+static volatile int64_t schedNextUs[MAX_SCHED]; // prazo armado (esp_timer), -1 = desarmado
+static volatile uint32_t schedFired = 0, schedSkipped = 0;
+TaskHandle_t schedTask = nullptr;
+
+static inline bool clockSynced(){ return time(nullptr) > 1700000000; }
+
+// Parseia {"tz":..., "entries":[{"kind","spec","loops","on"}]} para schedCfg. Erro -> mensagem.
+bool schedParse(const String& json, String& err){
+  DynamicJsonDocument doc(4096);
+  if(deserializeJson(doc, json)!=DeserializationError::Ok){ err="json"; return false; }
+  SchedEntry tmp[MAX_SCHED]; int n=0;
+  for(JsonObject o : doc["entries"].as<JsonArray>()){
+    if(n>=MAX_SCHED){ err="max entries"; return false; }
+    SchedEntry e; memset(&e, 0, sizeof(e));
+    String kind = (const char*)(o["kind"] | "cron");
+    String spec = (const char*)(o["spec"] | "");
+    e.on    = o["on"] | true;
+    e.loops = o["loops"] | 1;
+    e.pin   = -1;
+    spec.trim();
+    if(kind=="cron"){
+      e.kind=SK_CRON;
+      if(!cronParse(spec, e)){ err="cron: "+spec; return false; }
+    }else if(kind=="in"){
+      e.kind=SK_IN;
+      if(!allDigits(spec)){ err="in: "+spec; return false; }
+      e.inSec=spec.toInt();
+    }else if(kind=="gpio"){
+      e.kind=SK_GPIO;
+      int c=spec.indexOf(':');
+      String ps = c<0 ? spec : spec.substring(0,c);
+      String ed = c<0 ? "rising" : spec.substring(c+1);
+      if(!allDigits(ps) || !schedPinOk(ps.toInt())){ err="gpio: "+spec; return false; }
+      e.pin=ps.toInt();
+      e.edge = (ed=="falling") ? FALLING : RISING;
+    }else if(kind=="event"){
+      e.kind=SK_EVENT;
+      if(!spec.length() || spec.length()>=sizeof(e.name)){ err="event: "+spec; return false; }
+      strncpy(e.name, spec.c_str(), sizeof(e.name)-1);
+    }else{ err="kind: "+kind; return false; }
+    tmp[n++]=e;
+  }
+  String tz = (const char*)(doc["tz"] | "UTC0");
+  portENTER_CRITICAL(&schedMux);
+  memcpy(schedCfg, tmp, sizeof(SchedEntry)*n); schedCfgCount=n;
+  portEXIT_CRITICAL(&schedMux);
+  if(tz!=schedTz){ schedTz=tz; configTzTime(schedTz.c_str(), "pool.ntp.org", "time.google.com"); }
+  schedJson = json;
+  if(schedTask) xTaskNotify(schedTask, SCHED_RELOAD, eSetBits);
+  return true;
+}
+
+// Evento nomeado (HTTP ou CDC): marca as entradas correspondentes. Roda no loop task.
+int schedEvent(const String& name){
+  uint32_t bits=0;
+  for(int i=0;i<schedCfgCount;i++)
+    if(schedCfg[i].kind==SK_EVENT && schedCfg[i].on && name==schedCfg[i].name) bits |= 1UL<<i;
+  if(bits && schedTask) xTaskNotify(schedTask, bits, eSetBits);
+  return __builtin_popcount(bits);
+}
+
+void IRAM_ATTR schedGpioIsr(void* arg){
+  BaseType_t woken=pdFALSE;
+  xTaskNotifyFromISR(schedTask, 1UL<<(uint32_t)(uintptr_t)arg, eSetBits, &woken);
+  portYIELD_FROM_ISR(woken);
+}
+
+void schedLaunch(int i){
+  // não atropela uma execução nem um dry-run em curso; reserva no mesmo lock do dryBegin
+  portENTER_CRITICAL(&runMux);
+  bool busy = runningLoop || runBusy;
+  if(!busy) runningLoop = true;
+  portEXIT_CRITICAL(&runMux);
+  if(busy){ schedSkipped++; return; }
+  schedFired++;
+  startRun(schedEnt[i].loops);
+}
+
+// Arma a entrada i (cron/in) relativo a agora; -1 se não tem prazo.
+int64_t schedArm(int i, int64_t nowUsReal, bool boot){
+  const SchedEntry& e=schedEnt[i];
+  if(!e.on) return -1;
+  if(e.kind==SK_IN) return boot ? nowUsReal + (int64_t)e.inSec*1000000LL : -1;
+  if(e.kind!=SK_CRON || !clockSynced()) return -1;
+  time_t now=time(nullptr);
+  time_t nx=cronNext(e, now);
+  if(!nx) return -1;
+  return nowUsReal + (int64_t)(nx - now)*1000000LL;
+}
+
+void scheduler(void*){
+  int8_t  order[MAX_SCHED];     // fila de timers: índices ordenados por prazo
+  int     nOrder=0;
+  int64_t lastGpioUs[MAX_SCHED] = {0};
+  bool    reload=true;
+  while(true){
+    int64_t now=esp_timer_get_time();
+    if(reload){
+      for(int i=0;i<schedCount;i++) if(schedEnt[i].kind==SK_GPIO && schedEnt[i].pin>=0) detachInterrupt(schedEnt[i].pin);
+      portENTER_CRITICAL(&schedMux);
+      memcpy(schedEnt, schedCfg, sizeof(SchedEntry)*schedCfgCount); schedCount=schedCfgCount;
+      portEXIT_CRITICAL(&schedMux);
+      for(int i=0;i<MAX_SCHED;i++) schedNextUs[i] = (i<schedCount) ? schedArm(i, now, true) : -1;
+      for(int i=0;i<schedCount;i++){
+        const SchedEntry& e=schedEnt[i];
+        if(e.on && e.kind==SK_GPIO){ pinMode(e.pin, INPUT_PULLUP); attachInterruptArg(e.pin, schedGpioIsr, (void*)(uintptr_t)i, e.edge); }
+      }
+      reload=false;
+    }
+    // reconstrói a fila ordenada (<= MAX_SCHED entradas: inserção simples)
+    nOrder=0;
+    for(int i=0;i<schedCount;i++){
+      if(schedNextUs[i]<0) continue;
+      int k=nOrder++;
+      while(k>0 && schedNextUs[order[k-1]] > schedNextUs[i]){ order[k]=order[k-1]; k--; }
+      order[k]=i;
     }
+    bool needClock=false;
+    for(int i=0;i<schedCount;i++) if(schedEnt[i].on && schedEnt[i].kind==SK_CRON && schedNextUs[i]<0) needClock=true;
+
+    TickType_t wait = portMAX_DELAY;
+    if(nOrder) wait = (schedNextUs[order[0]] <= now) ? 0 : pdMS_TO_TICKS((schedNextUs[order[0]]-now)/1000 + 1);
+    if(needClock && (wait==portMAX_DELAY || wait>pdMS_TO_TICKS(30000))) wait = pdMS_TO_TICKS(30000); // aguarda SNTP
+
+    uint32_t bits=0;
+    xTaskNotifyWait(0, 0xFFFFFFFFu, &bits, wait);
+    now=esp_timer_get_time();
+    if(bits & SCHED_RELOAD){ reload=true; continue; }
+
+    for(int i=0;i<schedCount;i++){
+      if(!(bits & (1UL<<i)) || !schedEnt[i].on) continue;
+      if(schedEnt[i].kind==SK_GPIO){
+        if(now - lastGpioUs[i] < 200000) continue;
+        lastGpioUs[i]=now;
+      }
+      schedLaunch(i);
+    }
+    for(int k=0;k<nOrder;k++){
+      int i=order[k];
+      if(schedNextUs[i] > now) break;
+      schedLaunch(i);
+      schedNextUs[i] = (schedEnt[i].kind==SK_CRON) ? schedArm(i, now, false) : -1;
+    }
+    // cron sem prazo (relógio acabou de sincronizar)
+    for(int i=0;i<schedCount;i++)
+      if(schedEnt[i].kind==SK_CRON && schedNextUs[i]<0) schedNextUs[i]=schedArm(i, now, false);
   }
 }
 
@@ -351,8 +744,9 @@ void proxyPcCapture() {
 // ================= HTML UI =================
 String htmlPage(){
   String rows;
-  for(int i=0;i<stepCount;i++){
-    const Step& s=steps[i];
+  const std::vector<Step> cur = macroEffective();
+  for(int i=0;i<(int)cur.size();i++){
+    const Step& s=cur[i];
     rows += "<tr>"
       "<td>"+String(i+1)+"</td>"
       "<td>"+s.type+"</td>"
@@ -370,7 +764,7 @@ String htmlPage(){
       "</td>"
     "</tr>";
   }
-  if(stepCount==0) rows += "<tr><td colspan='10' style='color:#666'>Sem passos ainda. Use os botões de captura abaixo.</td></tr>";
+  if(cur.empty()) rows += "<tr><td colspan='10' style='color:#666'>Sem passos ainda. Use os botões de captura abaixo.</td></tr>";
 
   String p = R"HTML(
 <!doctype html><html lang="pt-br"><meta charset="utf-8">
@@ -407,7 +801,14 @@ String htmlPage(){
   <label>Screen H <input name="h" type="number" value="__H__"></label>
   <label>Counts/px <input name="cpp" type="number" step="0.1" value="__CPP__"></label>
   <label>Delay padrão (ms) <input name="delay" type="number" value="__DELAY__"></label>
+  <label>IP fixo (vazio = DHCP) <input name="ip" value="__IP__"></label>
+  <label>Gateway <input name="gw" value="__GW__"></label>
   <label>AutoRun <input name="autorun" type="checkbox" __AUTOCHECK__></label>
+  <label>Otimizar ao importar <input name="autoopt" type="checkbox" __OPTCHECK__></label>
+  <label>Jitter <input name="jon" type="checkbox" __JONCHECK__></label>
+  <label>Seed <input name="jseed" type="number" min="0" value="__JSEED__"></label>
+  <label>Delay ±% <input name="jpct" type="number" min="0" max="100" value="__JPCT__"></label>
+  <label>Posição ±px <input name="jpos" type="number" min="0" max="100" value="__JPOS__"></label>
   <button type="submit" class="btn-good">Salvar Config</button>
   <button type="button" class="btn-go" onclick="location.href='/test'">Testar /health</button>
   <a href="/export"><button type="button" class="btn-gray">Exportar JSON</button></a>
@@ -429,6 +830,7 @@ __ROWS__
 </table>
 <div class="row">
   <button formaction="/clear" formmethod="POST" class="btn-gray">Limpar todos</button>
+  <button type="button" class="btn-gray" onclick="optimize()">Otimizar</button>
 </div>
 <div class="row">
   <label>Loops (N) <input id="loopN" type="number" min="1" max="100000" value="10"></label>
@@ -438,7 +840,9 @@ __ROWS__
   <button formaction="/stop"          formmethod="POST" class="btn-stop">Parar</button>
 </div>
 <div class="row">
-  <button type="button" class="btn-gray" onclick="fetch('/hidTest').then(()=>alert('HID test OK (movi 50px e cliquei)')).catch(()=>alert('Falha'))">Testar HID (mover 50px →)</button>
+  <button type="button" class="btn-gray" onclick="fetch('/hidTest').then(r=>alert(r.ok ? 'HID test OK (movi 50px e cliquei)' : 'Macro rodando: pare antes de testar')).catch(()=>alert('Falha'))">Testar HID (mover 50px →)</button>
+  <button type="button" class="btn-gray" onclick="dryRun()">Dry-run (timeline)</button>
+  <a href="/trace"><button type="button" class="btn-gray">Baixar trace</button></a>
 </div>
 </form>
 
@@ -479,7 +883,24 @@ __ROWS__
   <small>Depois de capturar e salvar os passos, você pode desligar o serviço Go. O ESP roda solo via HID.</small>
 </div>
 
+<div class="card">
+  <h3>Agendamentos</h3>
+  <textarea id="schedJson" rows="6" style="width:100%;max-width:1200px"></textarea>
+  <div class="row">
+    <button type="button" class="btn-good" onclick="saveSched()">Salvar agendamentos</button>
+  </div>
+  <small>kind: <code>cron</code> ("*/15 8-18 * * 1-5"), <code>in</code> (segundos após boot), <code>gpio</code> ("4:falling"), <code>event</code> (POST /event?name=...). loops: 0 = ∞. tz: POSIX, ex. "&lt;-03&gt;3".</small>
+</div>
+
 <script>
+fetch('/sched').then(r=>r.json()).then(s=>{
+  document.getElementById('schedJson').value = JSON.stringify({tz:s.tz, entries:s.entries}, null, 1);
+}).catch(()=>{});
+function saveSched(){
+  let obj; try{ obj = JSON.parse(document.getElementById('schedJson').value); }catch(e){ alert('JSON inválido'); return; }
+  postJSON('/sched', obj).then(r=>r.json()).then(o=>alert(o.ok ? 'Agendamentos salvos' : ('Erro: '+o.error))).catch(()=>alert('Falha'));
+}
+
 function upd(){
   fetch('/status').then(r=>r.json()).then(s=>{
     document.getElementById('st_mode').textContent = s.running ? (s.loop?'loop':'running') : 'standby';
@@ -498,6 +919,20 @@ async function getJSON(url){ const r=await fetch(url); return await r.json(); }
 function getDelay(){ const el=document.getElementById('capDelay'); const v=el? (+el.value||0) : 0; return Math.max(0, Math.min(30, v)); }
 function val(id, fallback){ const el=document.getElementById(id); return el? (+el.value||fallback) : fallback; }
 
+function dryRun(){
+  fetch('/runOnce?dry=1', { method:'POST' }).then(r=>r.json()).then(t=>{
+    if(t.error){ alert('Dry-run: '+t.error); return; }
+    alert(`Dry-run: ${Math.round(t.busy_ms)} ms HID + ${Math.round(t.idle_ms)} ms de delay por loop`);
+  }).catch(()=>alert('Falha'));
+}
+
+function optimize(){
+  fetch('/optimize', { method:'POST' }).then(r=>r.json()).then(o=>{
+    const saved = (typeof o.saved_ms==='number') ? ` — ~${Math.round(o.saved_ms)} ms/loop a menos` : '';
+    alert(`Otimizado: ${o.before} → ${o.after} passos${saved}`); location.reload();
+  }).catch(()=>alert('Falha'));
+}
+
 function runLoopN(){
   const n = Math.max(1, Math.min(100000, parseInt(document.getElementById('loopN').value)||1));
   fetch('/runLoop?n='+n, { method:'POST' }).then(()=>{}).catch(()=>{});
@@ -575,7 +1010,14 @@ async function addKey(){
   p.replace("__H__", String(screenH));
   p.replace("__CPP__", String(countsPerPixel,1));
   p.replace("__DELAY__", String(actionDelay));
+  p.replace("__IP__", netIp);
+  p.replace("__GW__", netGw);
   p.replace("__AUTOCHECK__", autoRunOnBoot ? "checked" : "");
+  p.replace("__OPTCHECK__", autoOptimize ? "checked" : "");
+  p.replace("__JONCHECK__", jitter.on ? "checked" : "");
+  p.replace("__JSEED__", String(jitter.seed));
+  p.replace("__JPCT__", String(jitter.delayPct));
+  p.replace("__JPOS__", String(jitter.posPx));
   p.replace("__ROWS__", rows);
   p.replace("__LOOPS__", String(loopsRemaining));
   return p;
@@ -585,12 +1027,19 @@ async function addKey(){
 void handleRoot(){ sendCORS(); server.send(200,"text/html; charset=utf-8", htmlPage()); }
 
 void handleStatus(){
-  DynamicJsonDocument d(256);
+  DynamicJsonDocument d(512);
+  d["id"]      = (const char*)deviceId;
   d["running"] = runningLoop;
   d["loop"] = runningLoop;
   d["step"] = runStepIndex;
   d["count"]= stepCount;
   d["loops_left"]= (int)loopsRemaining; // -1 = ∞
+  d["hid_q"]        = hidQDepth();
+  d["hid_q_max"]    = hidQ.maxDepth;
+  d["hid_underruns"]= hidQ.underruns;
+  d["armed"]   = startAtUs != 0;
+  d["ip"]      = WiFi.localIP().toString();
+  d["dhcp"]    = netIp.length() == 0;
   String s; serializeJson(d,s); sendJSON(200,s);
 }
 
@@ -598,14 +1047,10 @@ void handleExport(){
   DynamicJsonDocument doc(32768);
   JsonObject cfg = doc.createNestedObject("config");
   cfg["w"]=screenW; cfg["h"]=screenH; cfg["cpp"]=countsPerPixel; cfg["delay"]=actionDelay; cfg["autorun"]=autoRunOnBoot;
-  cfg["host"]=pcHost; cfg["port"]=pcPort;
+  cfg["host"]=pcHost; cfg["port"]=pcPort; cfg["optimize"]=autoOptimize;
+  jitterToJson(cfg.createNestedObject("jitter"));
   JsonArray arr = doc.createNestedArray("steps");
-  for(int i=0;i<stepCount;i++){
-    JsonObject o = arr.createNestedObject();
-    o["type"]=steps[i].type; o["x"]=steps[i].x; o["y"]=steps[i].y; o["x2"]=steps[i].x2; o["y2"]=steps[i].y2;
-    o["text"]=steps[i].text; o["btn"]=steps[i].btn;
-    o["delayMs"]=steps[i].delayMs; o["durMs"]=steps[i].durMs; o["stepsN"]=steps[i].stepsN;
-  }
+  for(const Step& st : macroEffective()) stepToJson(arr.createNestedObject(), st);
   String s; serializeJson(doc,s); sendJSON(200,s);
 }
 
@@ -614,6 +1059,15 @@ void handleImport(){
   DynamicJsonDocument doc(32768);
   if(deserializeJson(doc, server.arg("cfg"))!=DeserializationError::Ok){ sendJSON(400,"{\"error\":\"json\"}"); return; }
 
+  std::vector<Step> v;
+  if(doc["steps"].is<JsonArray>()){
+    for(JsonObject o: doc["steps"].as<JsonArray>()){
+      if((int)v.size()>=MAX_STEPS) break;
+      v.push_back(stepFromJson(o));
+    }
+  }
+  if(!stepsValid(v)) return;   // nada muda, nem a config
+
   if(doc["config"].is<JsonObject>()){
     JsonObject c = doc["config"];
     screenW = c["w"] | screenW;
@@ -623,25 +1077,13 @@ void handleImport(){
     autoRunOnBoot = c["autorun"] | autoRunOnBoot;
     pcHost = (const char*)(c["host"] | pcHost.c_str());
     pcPort = c["port"] | pcPort;
+    autoOptimize = c["optimize"] | autoOptimize;
+    if(c["jitter"].is<JsonObject>()) jitterFromJson(c["jitter"].as<JsonObject>());
   }
 
-  stepCount=0;
-  if(doc["steps"].is<JsonArray>()){
-    for(JsonObject o: doc["steps"].as<JsonArray>()){
-      if(stepCount>=MAX_STEPS) break;
-      Step st;
-      st.type=(const char*)o["type"];
-      st.x=o["x"]|0; st.y=o["y"]|0; st.x2=o["x2"]|0; st.y2=o["y2"]|0;
-      st.text=(const char*)(o["text"]|"");
-      st.btn = (const char*)(o["btn"] | (const char*)(o["button"] | "left"));
-      st.delayMs = o["delayMs"] | (o["ms"] | 0);
-      st.durMs   = o["durMs"]   | 600;
-      st.stepsN  = o["stepsN"]  | 1;
-      if(st.stepsN < 1) st.stepsN = 1;
-      steps[stepCount++]=st;
-    }
-  }
-  persistAll();
+  if(autoOptimize) v.resize(optimizeSteps(v.data(), (int)v.size()));
+  persistAll();        // config; a macro persiste quando for aplicada
+  macroCommit(v);
   server.sendHeader("Location","/"); sendCORS(); server.send(302);
 }
 
@@ -653,41 +1095,259 @@ void handleSaveCfg(){
   countsPerPixel = server.arg("cpp").length()? server.arg("cpp").toFloat() : countsPerPixel;
   actionDelay = server.arg("delay").length()? server.arg("delay").toInt() : actionDelay; // pode ajustar
   autoRunOnBoot = server.hasArg("autorun");
+  autoOptimize = server.hasArg("autoopt");
+  jitter.on = server.hasArg("jon");
+  if(server.arg("jseed").length()) jitter.seed = strtoul(server.arg("jseed").c_str(), nullptr, 10);
+  if(server.arg("jpct").length())  jitter.delayPct = constrain((int)server.arg("jpct").toInt(), 0, 100);
+  if(server.arg("jpos").length())  jitter.posPx = constrain((int)server.arg("jpos").toInt(), 0, 100);
+  // rede: vale no próximo boot; endereço inválido é ignorado
+  IPAddress chk;
+  if(server.hasArg("ip") && (!server.arg("ip").length() || chk.fromString(server.arg("ip")))) netIp = server.arg("ip");
+  if(server.hasArg("gw") && chk.fromString(server.arg("gw"))) netGw = server.arg("gw");
   persistAll();
   server.sendHeader("Location","/"); sendCORS(); server.send(302);
 }
 
 // ===== gerenciamento da lista (AÇÕES por linha) =====
-void stepsSwap(int i,int j){ Step t=steps[i]; steps[i]=steps[j]; steps[j]=t; }
+// Editam a macro efetiva e gravam por macroCommit (com a macro rodando, valem no próximo loop).
 void handleStepsUp(){
   int i = server.hasArg("i")? server.arg("i").toInt() : -1;
-  if(i>0 && i<stepCount){ stepsSwap(i,i-1); persistAll(); }
+  std::vector<Step> v = macroEffective();
+  if(i>0 && i<(int)v.size()){ std::swap(v[i], v[i-1]); macroCommit(v); }
   server.sendHeader("Location","/"); sendCORS(); server.send(302);
 }
 void handleStepsDown(){
   int i = server.hasArg("i")? server.arg("i").toInt() : -1;
-  if(i>=0 && i<stepCount-1){ stepsSwap(i,i+1); persistAll(); }
+  std::vector<Step> v = macroEffective();
+  if(i>=0 && i<(int)v.size()-1){ std::swap(v[i], v[i+1]); macroCommit(v); }
   server.sendHeader("Location","/"); sendCORS(); server.send(302);
 }
 void handleStepsDel(){
   int i = server.hasArg("i")? server.arg("i").toInt() : -1;
-  if(i>=0 && i<stepCount){
-    for(int k=i;k<stepCount-1;k++) steps[k]=steps[k+1];
-    stepCount--; persistAll();
-  }
+  std::vector<Step> v = macroEffective();
+  if(i>=0 && i<(int)v.size()){ v.erase(v.begin()+i); macroCommit(v); }
   server.sendHeader("Location","/"); sendCORS(); server.send(302);
 }
 
-void handleClear(){ stepCount=0; persistAll(); server.sendHeader("Location","/"); sendCORS(); server.send(302); }
-void handleRunOnce(){ wantStop=false; runningLoop=false; loopsRemaining=0; runStepIndex=0; ledRunning(); runOnce(); server.sendHeader("Location","/"); sendCORS(); server.send(302); }
+void handleClear(){ macroCommit({}); server.sendHeader("Location","/"); sendCORS(); server.send(302); }
+void handleTraceSummary();
+void handleOptimize(){
+  // ?dry=1 só reporta; senão aplica e persiste
+  bool apply = server.arg("dry")!="1";
+  if(apply && (runningLoop || runBusy)){ sendJSON(409,"{\"error\":\"running\"}"); return; }  // o runner lê steps[]
+  const std::vector<Step> cur = macroEffective();
+  std::vector<Step> work = cur;
+  int n = optimizeSteps(work.data(), (int)work.size());
+  work.resize(n);
+
+  DynamicJsonDocument d(512);
+  d["ok"]=true; d["applied"]=apply;
+  d["before"]=(int)cur.size(); d["after"]=n;
+  if(dryBegin()){
+    // o dry-run usa o mesmo caminho de HID; só estima com o runner parado
+    uint64_t before = estimateLoopUs(cur.data(), (int)cur.size());
+    uint64_t after  = estimateLoopUs(work.data(), n);
+    dryEnd();
+    d["before_ms"]=before/1000.0; d["after_ms"]=after/1000.0;
+    d["saved_ms"]=(before>after? before-after : 0)/1000.0;
+  }
+  if(apply) macroCommit(work);
+  String s; serializeJson(d,s); sendJSON(200,s);
+}
+
+void handleRunOnce(){
+  if(server.arg("dry")=="1"){
+    // dry-run: mesma timeline, relógio virtual, nenhum report HID
+    if(!dryBegin()){ sendJSON(409,"{\"error\":\"running\"}"); return; }
+    traceClear(); dryClockUs=0; jitLoop=0;
+    runOnce();
+    dryEnd(); runStepIndex=0;
+    handleTraceSummary();
+    return;
+  }
+  // roda no runner (único produtor da fila HID) como um loop de 1 volta
+  runStepIndex=0; startRun(1);
+  server.sendHeader("Location","/"); sendCORS(); server.send(302);
+}
 void handleRunLoop(){
   long n = server.hasArg("n") ? server.arg("n").toInt() : 0; // n==0 => infinito
   if(n < 0) n = 0;
-  loopsRemaining = (n==0 ? -1 : n);
-  wantStop=false; runningLoop=true; ledRunning();
+  int64_t at = server.hasArg("at") ? strtoll(server.arg("at").c_str(), nullptr, 10) : 0; // µs do /clock
+  // com at: reserva o runner no mesmo lock do schedLaunch (runAdmit em runctl.h)
+  portENTER_CRITICAL(&runMux);
+  const char* err = runAdmit(at, esp_timer_get_time(), runningLoop, runBusy);
+  if(!err && at) runningLoop = true;
+  portEXIT_CRITICAL(&runMux);
+  if(err){ sendJSON(409, String("{\"error\":\"") + err + "\"}"); return; }
+  startRun(n, at);
   sendCORS(); server.send(200,"application/json","{\"ok\":true}");
 }
-void handleStop(){ wantStop=true; runningLoop=false; loopsRemaining=0; ledStopped(); server.sendHeader("Location","/"); sendCORS(); server.send(302); }
+void handleStop(){
+  wantStop=true; runningLoop=false; loopsRemaining=0; startAtUs=0; ledStopped();
+  if(hidPumpTask) xTaskNotifyGive(hidPumpTask);  // acorda o consumidor no meio de um WAIT
+  if(runnerTask) xTaskNotifyGive(runnerTask);    // cancela um início armado
+  server.sendHeader("Location","/"); sendCORS(); server.send(302);
+}
+
+// ===== OTA (duas partições app; rollback se o app novo não confirmar) =====
+static uint32_t otaT0 = 0;
+static size_t   otaBytes = 0;
+static String   otaErr;
+static bool     otaSeen = false;   // houve upload (FILE_START) nesta requisição
+
+void handleOtaUpload(){
+  HTTPUpload& up = server.upload();
+  if(up.status==UPLOAD_FILE_START){
+    otaErr=""; otaBytes=0; otaT0=millis(); otaSeen=true;
+    if(!Update.begin(UPDATE_SIZE_UNKNOWN)) otaErr=Update.errorString();
+    else if(server.hasArg("md5") && !Update.setMD5(server.arg("md5").c_str())) otaErr="md5";
+  }else if(up.status==UPLOAD_FILE_WRITE){
+    if(!otaErr.length() && Update.write(up.buf, up.currentSize)!=up.currentSize) otaErr=Update.errorString();
+    otaBytes += up.currentSize;
+  }else if(up.status==UPLOAD_FILE_END){
+    if(!otaErr.length() && !Update.end(true)) otaErr=Update.errorString();  // confere o MD5
+  }else if(up.status==UPLOAD_FILE_ABORTED){
+    Update.abort(); otaErr="aborted";
+  }
+}
+// Só reinicia com uma imagem completa e conferida vinda desta requisição; o estado não sobrevive a ela.
+void handleOtaDone(){
+  DynamicJsonDocument d(256);
+  int code = 200;
+  if(!otaSeen){ code=400; d["error"]="no file"; }
+  else if(otaErr.length() || !Update.isFinished()){
+    if(Update.isRunning()) Update.abort();
+    code=500; d["error"] = otaErr.length() ? otaErr : String("incomplete");
+  }
+  otaSeen=false; otaErr="";
+  if(code!=200){ String s; serializeJson(d,s); sendJSON(code,s); return; }
+  pendingReboot = true;   // loop() reinicia quando o runner estiver entre loops/ocioso
+  d["ok"]=true; d["bytes"]=otaBytes; d["ms"]=millis()-otaT0;
+  d["apply"]= runningLoop ? "loop boundary" : "now";
+  String s; serializeJson(d,s); sendJSON(200,s);
+}
+void handleOtaInfo(){
+  DynamicJsonDocument d(384);
+  const esp_partition_t* run = esp_ota_get_running_partition();
+  const esp_partition_t* nxt = esp_ota_get_next_update_partition(nullptr);
+  esp_ota_img_states_t st;
+  d["running"] = run ? run->label : "";
+  d["next"]    = nxt ? nxt->label : "";
+  d["state"]   = (run && esp_ota_get_state_partition(run, &st)==ESP_OK) ? (int)st : -1;
+  d["can_rollback"]   = Update.canRollBack();
+  d["pending_reboot"] = pendingReboot;
+  String s; serializeJson(d,s); sendJSON(200,s);
+}
+void handleOtaRollback(){
+  if(!Update.canRollBack()){ sendJSON(409,"{\"error\":\"no rollback image\"}"); return; }
+  Update.rollBack(); pendingReboot = true;
+  okJSON();
+}
+
+// Confirma (ou rejeita) o app recém-gravado no primeiro boot. Sem Wi-Fi o device
+// fica inalcançável para o fleet, então volta para a imagem anterior.
+extern "C" bool verifyRollbackLater(){ return true; }
+void otaConfirm(bool healthy){
+  const esp_partition_t* run = esp_ota_get_running_partition();
+  esp_ota_img_states_t st;
+  if(!run || esp_ota_get_state_partition(run, &st)!=ESP_OK || st!=ESP_OTA_IMG_PENDING_VERIFY) return;
+  if(healthy){ esp_ota_mark_app_valid_cancel_rollback(); Serial.println("[OTA] app confirmado"); }
+  else { Serial.println("[OTA] app sem rede, rollback"); esp_ota_mark_app_invalid_rollback_and_reboot(); }
+}
+
+// ===== Macro em delta: manifest (CRC por passo) + só os passos alterados =====
+// Descreve a macro efetiva (a pendente, se houver): a mesma que o /macro/delta confere como base.
+void handleMacroManifest(){
+  DynamicJsonDocument d(8192);
+  xSemaphoreTake(macroMutex, portMAX_DELAY);
+  const Step* src = macroPending ? stagedSteps : steps;
+  const int   srcN = macroPending ? stagedCount : stepCount;
+  d["n"]   = srcN;
+  d["crc"] = hex32(macroCrc(src, srcN));
+  d["pending"] = macroPending;
+  JsonArray a = d.createNestedArray("steps");
+  for(int i=0;i<srcN;i++) a.add(hex32(stepCrc(src[i])));
+  xSemaphoreGive(macroMutex);
+  String s; serializeJson(d,s); sendJSON(200,s);
+}
+// {"base":"<crc atual>","n":N,"set":[{"i":3,"step":{...}}],"crc":"<crc final>"}
+void handleMacroDelta(){
+  if(!server.hasArg("plain")){ sendJSON(400,"{\"error\":\"no body\"}"); return; }
+  uint32_t t0=millis();
+  DynamicJsonDocument doc(32768);
+  if(deserializeJson(doc, server.arg("plain"))!=DeserializationError::Ok){ sendJSON(400,"{\"error\":\"json\"}"); return; }
+
+  xSemaphoreTake(macroMutex, portMAX_DELAY);
+  // base = macro efetiva (a pendente, se houver)
+  const Step* src = macroPending ? stagedSteps : steps;
+  const int   srcN = macroPending ? stagedCount : stepCount;
+  uint32_t cur = macroCrc(src, srcN);
+  uint32_t base = strtoul((const char*)(doc["base"] | ""), nullptr, 16);
+  uint32_t want = strtoul((const char*)(doc["crc"]  | ""), nullptr, 16);
+  int n = doc["n"] | -1;
+  const char* err = nullptr; int code = 400;
+  std::vector<Step> work;
+  int nset = 0;
+  if(base != cur){ err="base mismatch"; code=409; }
+  else if(n<0 || n>MAX_STEPS) err="n";
+  else{
+    work.assign(src, src + min(n, srcN));
+    work.resize(n);
+    std::vector<bool> have(n, false);
+    for(int i=0;i<min(n, srcN);i++) have[i]=true;
+    for(JsonObject o : doc["set"].as<JsonArray>()){
+      int i = o["i"] | -1;
+      if(i<0 || i>=n){ err="index"; break; }
+      work[i]=stepFromJson(o["step"].as<JsonObject>()); have[i]=true; nset++;
+      if((err = stepInvalid(work[i]))) break;
+    }
+    for(int i=0;i<n && !err;i++) if(!have[i]) err="missing step";
+    if(!err && macroCrc(work.data(), n)!=want){ err="crc mismatch"; code=422; }
+  }
+  if(!err){
+    for(int i=0;i<n;i++) stagedSteps[i]=work[i];
+    stagedCount=n; macroPending=true;
+  }
+  xSemaphoreGive(macroMutex);
+
+  DynamicJsonDocument d(256);
+  if(err){ d["error"]=err; d["crc"]=hex32(cur); String s; serializeJson(d,s); sendJSON(code,s); return; }
+  d["ok"]=true; d["set"]=nset; d["n"]=n; d["ms"]=millis()-t0;
+  d["applied"]=applyStagedIfIdle();   // ocioso: aplica já
+  String s; serializeJson(d,s); sendJSON(200,s);
+}
+
+// Relógio monotônico (µs desde o boot) p/ o fleet estimar o offset e armar /runLoop?at=
+void handleClock(){
+  char b[48]; snprintf(b, sizeof(b), "{\"us\":%lld}", (long long)esp_timer_get_time());
+  sendJSON(200, b);
+}
+
+// ===== Agendador =====
+void handleSchedGet(){
+  DynamicJsonDocument d(6144);
+  if(deserializeJson(d, schedJson)!=DeserializationError::Ok){ sendErrorJSON("sched json"); return; }
+  d["synced"]  = clockSynced();
+  d["now"]     = (long)time(nullptr);
+  d["fired"]   = schedFired;
+  d["skipped"] = schedSkipped;
+  JsonArray nx = d.createNestedArray("next_in_s");   // -1 = sem prazo (gpio/event/desarmado)
+  int64_t now = esp_timer_get_time();
+  for(int i=0;i<schedCfgCount;i++) nx.add(schedNextUs[i]<0 ? -1L : (long)((schedNextUs[i]-now)/1000000));
+  String s; serializeJson(d,s); sendJSON(200,s);
+}
+void handleSchedSet(){
+  if(!server.hasArg("plain")){ sendJSON(400,"{\"error\":\"no body\"}"); return; }
+  String err;
+  if(!schedParse(server.arg("plain"), err)){ errJSON(400, err); return; }
+  persistAll();
+  okJSON();
+}
+void handleEvent(){
+  String name = server.arg("name");
+  if(!name.length()){ sendJSON(400,"{\"error\":\"no name\"}"); return; }
+  sendJSON(200, String("{\"ok\":true,\"matched\":") + schedEvent(name) + "}");
+}
 
 void handleTest(){
   String url = "http://" + pcHost + ":" + String(pcPort) + "/health";
@@ -698,9 +1358,66 @@ void handleTest(){
   }else sendJSON(500,"{\"error\":\"begin failed\"}");
 }
 
-// Diagnóstico HID
+// ===== Timeline: export Chrome trace (chrome://tracing / Perfetto) e resumo =====
+void handleTrace(){
+  uint32_t wr = trace.wr;
+  uint32_t first = (wr > (uint32_t)TRACE_CAP) ? wr - TRACE_CAP : 0;
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  sendCORS();
+  server.sendHeader("Content-Disposition","attachment; filename=\"autoclicker-trace.json\"");
+  server.send(200, "application/json", "");
+  String out = TRACE_JSON_HEAD;
+  char buf[160];
+  for(uint32_t i=first;i<wr;i++){
+    TraceEv e; if(!traceGet(i,e)) continue;
+    traceJsonEv(buf, sizeof(buf), e);
+    out += buf;
+    if(out.length() > 1024){ server.sendContent(out); out = ""; }
+  }
+  out += TRACE_JSON_TAIL;
+  server.sendContent(out);
+  server.sendContent("");
+}
+
+// Resumo do último loop (acumuladores: completo mesmo com o ring cheio).
+void handleTraceSummary(){
+  uint32_t wr = trace.wr;
+  uint32_t first = (wr > (uint32_t)TRACE_CAP) ? wr - TRACE_CAP : 0;
+  uint64_t phaseUs[PH_COUNT];
+  uint32_t phaseN[PH_COUNT];
+  std::vector<uint64_t> busyUs(stepCount+1), idleUs(stepCount+1);
+  portENTER_CRITICAL(&traceMux);
+  memcpy(phaseUs, trace.phaseUs, sizeof(phaseUs)); memcpy(phaseN, trace.phaseN, sizeof(phaseN));
+  for(int i=0;i<=stepCount;i++){ busyUs[i]=trace.busyUs[i]; idleUs[i]=trace.idleUs[i]; }
+  const uint64_t loopUs = trace.t1Us - trace.t0Us;
+  portEXIT_CRITICAL(&traceMux);
+  DynamicJsonDocument d(8192);
+  d["events"]  = wr - first;   // eventos no ring (export Chrome)
+  d["dropped"] = first;
+  d["loop_ms"] = loopUs/1000.0;
+  uint64_t busy=0;
+  JsonObject ph = d.createNestedObject("phases");
+  for(int p=0;p<PH_COUNT;p++){
+    JsonObject o = ph.createNestedObject(PHASE_NAMES[p]);
+    o["n"] = phaseN[p]; o["ms"] = phaseUs[p]/1000.0;
+    if(p!=PH_DELAY) busy += phaseUs[p];
+  }
+  d["busy_ms"] = busy/1000.0;
+  d["idle_ms"] = phaseUs[PH_DELAY]/1000.0;
+  JsonArray st = d.createNestedArray("steps");
+  for(int i=1;i<=stepCount;i++){
+    JsonObject o = st.createNestedObject();
+    o["i"]=i; o["type"]=steps[i-1].type; o["busy_ms"]=busyUs[i]/1000.0; o["idle_ms"]=idleUs[i]/1000.0;
+  }
+  String s; serializeJson(d,s); sendJSON(200,s);
+}
+void handleTraceClear(){ traceClear(); okJSON(); }
+
+// Diagnóstico HID: manda direto, sem fila; só com o runner parado (a hidPump é o único consumidor).
 void handleHidTest(){
+  if(!runReserve()){ sendJSON(409,"{\"error\":\"running\"}"); return; }
   Mouse.move(50, 0); delay(50); Mouse.press(MOUSE_LEFT); delay(50); Mouse.release(MOUSE_LEFT);
+  runBusy=false;
   sendJSON(200, "{\"ok\":true}");
 }
 
@@ -710,61 +1427,36 @@ void handleSetSteps(){
   DynamicJsonDocument doc(32768);
   if(deserializeJson(doc, server.arg("plain"))!=DeserializationError::Ok){ sendJSON(400,"{\"error\":\"json\"}"); return; }
 
-  stepCount=0;
+  std::vector<Step> v;
   for(JsonObject o: doc["steps"].as<JsonArray>()){
-    if(stepCount>=MAX_STEPS) break;
-    Step st;
-    st.type   = (const char*)o["type"];
-    st.x      = o["x"]   | 0;
-    st.y      = o["y"]   | 0;
-    st.x2     = o["x2"]  | 0;
-    st.y2     = o["y2"]  | 0;
-    st.text   = (const char*)(o["text"] | "");
-    st.btn    = (const char*)(o["btn"]  | (const char*)(o["button"] | "left"));
-    st.delayMs= o["delayMs"] | (o["ms"] | 0);
-    st.durMs  = o["durMs"]   | 600;
-    st.stepsN = o["stepsN"]  | 1;
-    if(st.stepsN < 1) st.stepsN = 1;
-    steps[stepCount++] = st;
+    if((int)v.size()>=MAX_STEPS) break;
+    v.push_back(stepFromJson(o));
   }
-  persistAll();
-  okJSON();
+  if(!stepsValid(v)) return;
+  if(autoOptimize) v.resize(optimizeSteps(v.data(), (int)v.size()));
+  bool applied = macroCommit(v);
+  sendJSON(200, applied ? "{\"ok\":true,\"applied\":true}" : "{\"ok\":true,\"applied\":false}");
 }
 void handleAddStep(){
   if(!server.hasArg("plain")){ sendJSON(400,"{\"error\":\"no body\"}"); return; }
   DynamicJsonDocument d(2048);
   if(deserializeJson(d, server.arg("plain"))!=DeserializationError::Ok){ sendJSON(400,"{\"error\":\"json\"}"); return; }
-  if(stepCount>=MAX_STEPS){ sendJSON(400,"{\"error\":\"max steps\"}"); return; }
-
-  Step st;
-  st.type   = (const char*)d["type"];
-  st.x      = d["x"]   | 0;
-  st.y      = d["y"]   | 0;
-  st.x2     = d["x2"]  | 0;
-  st.y2     = d["y2"]  | 0;
-  st.text   = (const char*)(d["text"] | "");
-  st.btn    = (const char*)(d["btn"]  | (const char*)(d["button"] | "left"));
-  st.delayMs= d["delayMs"] | (d["ms"] | 0);
-  st.durMs  = d["durMs"]   | 600;
-  st.stepsN = d["stepsN"]  | 1;
-  if(st.stepsN < 1) st.stepsN = 1;
+  std::vector<Step> v = macroEffective();
+  if((int)v.size()>=MAX_STEPS){ sendJSON(400,"{\"error\":\"max steps\"}"); return; }
 
-  steps[stepCount++] = st;
-  persistAll();
+  Step st = stepFromJson(d.as<JsonObject>());
+  if(const char* e = stepInvalid(st)){ errJSON(400, e); return; }
+  v.push_back(st);
+  macroCommit(v);
   okJSON();
 }
 void handleGetSteps(){
   DynamicJsonDocument doc(32768);
   JsonArray arr = doc.createNestedArray("steps");
-  for(int i=0;i<stepCount;i++){
-    JsonObject o = arr.createNestedObject();
-    o["type"]=steps[i].type; o["x"]=steps[i].x; o["y"]=steps[i].y;
-    o["x2"]=steps[i].x2; o["y2"]=steps[i].y2; o["text"]=steps[i].text;
-    o["btn"]=steps[i].btn; o["delayMs"]=steps[i].delayMs; o["durMs"]=steps[i].durMs; o["stepsN"]=steps[i].stepsN;
-  }
+  for(const Step& st : macroEffective()) stepToJson(arr.createNestedObject(), st);
   String s; serializeJson(doc,s); sendJSON(200,s);
 }
-void handleClearStepsAPI(){ stepCount=0; persistAll(); okJSON(); }
+void handleClearStepsAPI(){ macroCommit({}); okJSON(); }
 
 // Proxy Go
 void handlePcPos(){ proxyPcPos(); }
@@ -786,21 +1478,36 @@ void setup(){
   HID.begin();
   Mouse.begin();
   Keyboard.begin();
+  Consumer.begin();
+
+  loadAll();
 
   WiFi.mode(WIFI_STA);
-  WiFi.config(local_IP, gateway, subnet, dns1, dns2);
+  IPAddress ip, gw;
+  if(ip.fromString(netIp) && gw.fromString(netGw)) WiFi.config(ip, gw, subnet, dns1, dns2);
+  else Serial.println("[WiFi] sem IP fixo, DHCP");
   WiFi.begin(WIFI_SSID, WIFI_PASS);
   Serial.print("[WiFi] Conectando");
   for(int i=0;i<60 && WiFi.status()!=WL_CONNECTED;i++){ delay(250); Serial.print("."); }
   Serial.println();
   if(WiFi.status()==WL_CONNECTED){
     Serial.printf("[WiFi] OK %s\n", WiFi.localIP().toString().c_str());
-    if(MDNS.begin("autoclicker")){ MDNS.addService("http","tcp",80); }
+    // host fixo (autoclicker.local, como sempre); o id único por placa (fleet) vai na instância e no TXT
+    uint8_t mac[6]; WiFi.macAddress(mac);
+    snprintf(deviceId, sizeof(deviceId), "autoclicker-%02x%02x", mac[4], mac[5]);
+    if(MDNS.begin("autoclicker")){
+      MDNS.setInstanceName(deviceId);
+      MDNS.addService("http","tcp",80);
+      MDNS.addService("autoclicker","tcp",80);
+      MDNS.addServiceTxt("autoclicker","tcp","id",deviceId);
+    }
   } else {
     Serial.println("[WiFi] Falhou — siga usando só USB HID");
   }
 
-  loadAll();
+  String serr;
+  if(!schedParse(schedJson, serr)) Serial.printf("[SCHED] config inválida: %s\n", serr.c_str());
+  configTzTime(schedTz.c_str(), "pool.ntp.org", "time.google.com");
 
   // rotas
   server.onNotFound([](){
@@ -809,15 +1516,28 @@ void setup(){
   });
   server.on("/", HTTP_GET, handleRoot);
   server.on("/status", HTTP_GET, handleStatus);
+  server.on("/clock", HTTP_GET, handleClock);
+  server.on("/ota", HTTP_GET, handleOtaInfo);
+  server.on("/ota", HTTP_POST, handleOtaDone, handleOtaUpload);  // multipart, ?md5=...
+  server.on("/ota/rollback", HTTP_POST, handleOtaRollback);
+  server.on("/macro/manifest", HTTP_GET, handleMacroManifest);
+  server.on("/macro/delta", HTTP_POST, handleMacroDelta);
   server.on("/export", HTTP_GET, handleExport);
   server.on("/import", HTTP_POST, handleImport);
   server.on("/saveCfg", HTTP_POST, handleSaveCfg);
   server.on("/clear", HTTP_POST, handleClear);
+  server.on("/optimize", HTTP_POST, handleOptimize);  // aceita ?dry=1
   server.on("/runOnce", HTTP_POST, handleRunOnce);
   server.on("/runLoop", HTTP_POST, handleRunLoop); // aceita ?n=...
   server.on("/stop", HTTP_POST, handleStop);
   server.on("/test", HTTP_GET, handleTest);
   server.on("/hidTest", HTTP_GET, handleHidTest);
+  server.on("/trace", HTTP_GET, handleTrace);
+  server.on("/trace/summary", HTTP_GET, handleTraceSummary);
+  server.on("/trace/clear", HTTP_POST, handleTraceClear);
+  server.on("/sched", HTTP_GET, handleSchedGet);
+  server.on("/sched", HTTP_POST, handleSchedSet);
+  server.on("/event", HTTP_ANY, handleEvent);  // ?name=...
 
   // APIs e proxy
   server.on("/steps/set",   HTTP_POST, handleSetSteps);
@@ -836,9 +1556,15 @@ void setup(){
   server.on("/import",      HTTP_OPTIONS, handleOptions);
   server.on("/saveCfg",     HTTP_OPTIONS, handleOptions);
   server.on("/clear",       HTTP_OPTIONS, handleOptions);
+  server.on("/optimize",    HTTP_OPTIONS, handleOptions);
   server.on("/runOnce",     HTTP_OPTIONS, handleOptions);
   server.on("/runLoop",     HTTP_OPTIONS, handleOptions);
   server.on("/stop",        HTTP_OPTIONS, handleOptions);
+  server.on("/trace",       HTTP_OPTIONS, handleOptions);
+  server.on("/trace/summary", HTTP_OPTIONS, handleOptions);
+  server.on("/trace/clear", HTTP_OPTIONS, handleOptions);
+  server.on("/sched",       HTTP_OPTIONS, handleOptions);
+  server.on("/macro/delta", HTTP_OPTIONS, handleOptions);
   server.on("/steps/set",   HTTP_OPTIONS, handleOptions);
   server.on("/steps/add",   HTTP_OPTIONS, handleOptions);
   server.on("/steps/get",   HTTP_OPTIONS, handleOptions);
@@ -851,15 +1577,53 @@ void setup(){
 
   server.begin();
 
+  hidSyncSem = xSemaphoreCreateBinary();
+  macroMutex = xSemaphoreCreateMutex();
+  xTaskCreatePinnedToCore(hidPump, "hidPump", 3072, nullptr, 4, &hidPumpTask, 1);
   xTaskCreatePinnedToCore(runner, "runner", 4096, nullptr, 1, &runnerTask, 1);
 
-  if(autoRunOnBoot){
-    runningLoop=true; loopsRemaining=-1; ledRunning();
+  xTaskCreatePinnedToCore(scheduler, "sched", 4096, nullptr, 2, &schedTask, 0);
+
+  otaConfirm(WiFi.status()==WL_CONNECTED);
+
+  // retoma os loops interrompidos por um OTA
+  prefs.begin("cfg", false);
+  int resume = prefs.getInt("resume", 0);
+  if(resume) prefs.remove("resume");
+  prefs.end();
+
+  if(resume){
+    startRun(resume);
+  } else if(autoRunOnBoot){
+    startRun(0);
   } else {
     ledStandby();
   }
 
-  Serial.println("[READY] UI: http://192.168.0.44  | mDNS: http://autoclicker.local");
+  Serial.printf("[READY] UI: http://%s  | mDNS: http://autoclicker.local (%s)\n", WiFi.localIP().toString().c_str(), deviceId);
 }
 
-void loop(){ server.handleClient(); }
+// Linhas do CDC: "event <nome>" dispara entradas do agendador
+static String cdcLine;
+void pollCdc(){
+  while(Serial.available()){
+    char c=(char)Serial.read();
+    if(c=='\r') continue;
+    if(c!='\n'){ if(cdcLine.length()<64) cdcLine+=c; continue; }
+    String l=cdcLine; cdcLine="";
+    l.trim();
+    if(l.startsWith("event ")){
+      String n=l.substring(6); n.trim();
+      Serial.printf("[SCHED] event %s -> %d\n", n.c_str(), schedEvent(n));
+    }
+  }
+}
+
+void loop(){
+  server.handleClient();
+  pollCdc();
+  if(pendingReboot && !runningLoop && !runBusy){
+    delay(200);  // deixa a resposta HTTP sair
+    ESP.restart();
+  }
+}
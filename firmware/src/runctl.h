@@ -0,0 +1,25 @@
+#pragma once
+// Início armado do fleet (/runLoop?n=&at=): admissão do pedido e espera do runner até o instante.
+// Sem FreeRTOS aqui: o main.cpp chama sob runMux e dorme/gira conforme o retorno; os testes de host
+// (firmware/test/host) usam direto.
+#include <stdint.h>
+
+// O runner dorme até ~ARM_SPIN_US antes de at e gira o resto (o tick do FreeRTOS é 1 ms).
+static const int64_t ARM_SPIN_US = 2000;
+
+// Admite um pedido com at (µs do esp_timer; 0 = sem at, começa já como sempre). Retorna nullptr ou o
+// erro do 409. Com uma execução ou dry-run em curso o runner só olharia at depois do loop atual: o
+// início sairia fora de sincronia e o loop atual consumiria o n novo, então a placa recusa e o fleet
+// a reporta como não armada.
+inline const char* runAdmit(int64_t atUs, int64_t nowUs, bool running, bool busy){
+  if(!atUs) return nullptr;
+  if(atUs <= nowUs) return "at in the past";
+  if(running || busy) return "running";
+  return nullptr;
+}
+
+// Quanto o runner ainda pode dormir (ms) antes de girar até atUs; 0 = gira agora.
+inline uint32_t armSleepMs(int64_t atUs, int64_t nowUs){
+  const int64_t rem = atUs - nowUs;
+  return rem > ARM_SPIN_US + 1000 ? (uint32_t)((rem - ARM_SPIN_US) / 1000) : 0;
+}
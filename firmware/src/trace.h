@@ -0,0 +1,77 @@
+#pragma once
+// Timeline (profiler): cada fase de um passo vira um evento [t0, t0+dur) num ring fixo (export Chrome).
+// O resumo do último loop vem de acumuladores por fase/passo, que não perdem nada quando o ring dá a volta.
+// Sem lock e sem relógio aqui: o main.cpp protege com portMUX e passa o tempo (real ou o virtual do
+// dry-run); os testes de host (firmware/test/host) usam direto.
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "hidq.h"
+
+static const char* const PHASE_NAMES[PH_COUNT] = { "start", "home", "move", "button", "text", "key", "delay", "touch", "scroll" };
+
+struct TraceEv {
+  uint64_t t0Us;
+  uint32_t durUs;
+  uint16_t step;   // 1-based (0 = fora de passo)
+  uint8_t  phase;
+  uint8_t  run;    // contador de execuções (mod 256)
+};
+
+template<uint32_t CAP, int MAX_STEP>
+struct TraceLog {
+  TraceEv  buf[CAP];
+  uint32_t wr = 0;        // total escrito; slot = wr % CAP
+  uint8_t  run = 0;
+  bool     on = true;     // desligado nas estimativas do otimizador
+
+  // Acumuladores do último loop (zerados em runBegin)
+  uint64_t phaseUs[PH_COUNT] = {};
+  uint32_t phaseN[PH_COUNT] = {};
+  uint64_t busyUs[MAX_STEP+1] = {}, idleUs[MAX_STEP+1] = {};  // índice = passo 1-based
+  uint64_t t0Us = 0, t1Us = 0;   // início/fim do loop (válidos com any)
+  bool     any = false;
+
+  // Fase aberta por OP_PHASE (x=1 abre a fase a; x=0 fecha a aberta)
+  uint8_t  cur = PH_START;
+  uint64_t curT0 = 0;
+
+  void add(uint8_t ph, uint16_t step, uint64_t t0, uint64_t t1){
+    if(!on) return;
+    TraceEv e; e.t0Us=t0; e.durUs=(uint32_t)(t1-t0); e.step=step; e.phase=ph; e.run=run;
+    buf[wr % CAP] = e; wr++;
+    if(ph < PH_COUNT){
+      phaseUs[ph] += e.durUs; phaseN[ph]++;
+      if(step <= MAX_STEP){ if(ph==PH_DELAY) idleUs[step] += e.durUs; else busyUs[step] += e.durUs; }
+    }
+    if(!any || t0 < t0Us) t0Us = t0;   // o dry-run começa em t=0
+    if(!any || t1 > t1Us) t1Us = t1;
+    any = true;
+  }
+  void phase(const HidOp& o, uint16_t step, uint64_t now){
+    if(o.x){ cur=o.a; curT0=now; } else add(cur, step, curT0, now);
+  }
+  void runBegin(){
+    run++;
+    memset(phaseUs, 0, sizeof(phaseUs)); memset(phaseN, 0, sizeof(phaseN));
+    memset(busyUs, 0, sizeof(busyUs));   memset(idleUs, 0, sizeof(idleUs));
+    t0Us = t1Us = 0; any = false;
+  }
+  uint32_t first() const { return wr > CAP ? wr - CAP : 0; }   // mais antigo ainda no ring
+  bool get(uint32_t idx, TraceEv& out) const {
+    if(idx >= wr || wr - idx > CAP) return false;
+    out = buf[idx % CAP]; return true;
+  }
+  void clear(){ wr = 0; }
+};
+
+// Export Chrome trace (chrome://tracing / Perfetto): cabeçalho, um evento "X" por fase, rodapé.
+static const char TRACE_JSON_HEAD[] = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":["
+  "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"autoclicker\"}}";
+static const char TRACE_JSON_TAIL[] = "]}";
+
+inline int traceJsonEv(char* buf, size_t n, const TraceEv& e){
+  return snprintf(buf, n,
+    ",{\"name\":\"%s\",\"cat\":\"step\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%llu,\"dur\":%lu,\"args\":{\"step\":%u,\"run\":%u}}",
+    PHASE_NAMES[e.phase<PH_COUNT? e.phase : 0], (unsigned long long)e.t0Us, (unsigned long)e.durUs, (unsigned)e.step, (unsigned)e.run);
+}
@@ -0,0 +1,53 @@
+#pragma once
+// Shim mínimo de Arduino para os testes de host: só o que src/*.h usa (String, min/max, constrain).
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <algorithm>
+
+using std::min;
+using std::max;
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+class String {
+  std::string s;
+public:
+  String() {}
+  String(const char* c) : s(c ? c : "") {}
+  String(const std::string& c) : s(c) {}
+  explicit String(int v) : s(std::to_string(v)) {}
+  explicit String(long v) : s(std::to_string(v)) {}
+  explicit String(unsigned v) : s(std::to_string(v)) {}
+
+  unsigned length() const { return (unsigned)s.size(); }
+  const char* c_str() const { return s.c_str(); }
+  char operator[](unsigned i) const { return i < s.size() ? s[i] : 0; }
+
+  bool operator==(const String& o) const { return s == o.s; }
+  bool operator==(const char* o) const { return s == o; }
+  bool operator!=(const String& o) const { return s != o.s; }
+  bool operator!=(const char* o) const { return s != o; }
+
+  String& operator+=(const String& o) { s += o.s; return *this; }
+  String& operator+=(const char* o) { s += o; return *this; }
+  String& operator+=(char c) { s += c; return *this; }
+  String& operator+=(int v) { s += std::to_string(v); return *this; }
+  String& operator+=(long v) { s += std::to_string(v); return *this; }
+  String& operator+=(unsigned v) { s += std::to_string(v); return *this; }
+  friend String operator+(String a, const String& b) { a += b; return a; }
+  friend String operator+(String a, const char* b) { a += b; return a; }
+
+  void toLowerCase() { for (auto& c : s) c = (char)tolower((unsigned char)c); }
+  void trim() {
+    size_t a = s.find_first_not_of(" \t\r\n"), b = s.find_last_not_of(" \t\r\n");
+    s = (a == std::string::npos) ? "" : s.substr(a, b - a + 1);
+  }
+  int indexOf(char c, unsigned from = 0) const { size_t i = s.find(c, from); return i == std::string::npos ? -1 : (int)i; }
+  String substring(unsigned a) const { return a < s.size() ? String(s.substr(a)) : String(); }
+  String substring(unsigned a, unsigned b) const { return a < b && a < s.size() ? String(s.substr(a, b - a)) : String(); }
+  bool startsWith(const char* p) const { return s.rfind(p, 0) == 0; }
+  long toInt() const { return atol(s.c_str()); }
+};
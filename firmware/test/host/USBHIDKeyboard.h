@@ -0,0 +1,27 @@
+#pragma once
+// Constantes de USBHIDKeyboard (arduino-esp32) para os testes de host.
+#define KEY_LEFT_CTRL   0x80
+#define KEY_LEFT_SHIFT  0x81
+#define KEY_LEFT_ALT    0x82
+#define KEY_LEFT_GUI    0x83
+#define KEY_UP_ARROW    0xDA
+#define KEY_DOWN_ARROW  0xD9
+#define KEY_LEFT_ARROW  0xD8
+#define KEY_RIGHT_ARROW 0xD7
+#define KEY_BACKSPACE   0xB2
+#define KEY_TAB         0xB3
+#define KEY_RETURN      0xB0
+#define KEY_ESC         0xB1
+#define KEY_DELETE      0xD4
+#define KEY_F1  0xC2
+#define KEY_F2  0xC3
+#define KEY_F3  0xC4
+#define KEY_F4  0xC5
+#define KEY_F5  0xC6
+#define KEY_F6  0xC7
+#define KEY_F7  0xC8
+#define KEY_F8  0xC9
+#define KEY_F9  0xCA
+#define KEY_F10 0xCB
+#define KEY_F11 0xCC
+#define KEY_F12 0xCD
@@ -0,0 +1,5 @@
+#pragma once
+// Constantes de USBHIDMouse (arduino-esp32) para os testes de host.
+#define MOUSE_LEFT   0x01
+#define MOUSE_RIGHT  0x02
+#define MOUSE_MIDDLE 0x04
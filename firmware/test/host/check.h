@@ -0,0 +1,19 @@
+#pragma once
+// Mini-harness dos testes de host: CHECK/CHECK_EQ contam falhas; TEST_MAIN devolve o status.
+#include <stdio.h>
+
+static int checkFails = 0, checkCount = 0;
+
+#define CHECK(cond) do { checkCount++; if(!(cond)){ checkFails++; \
+  fprintf(stderr, "%s:%d: CHECK(%s)\n", __FILE__, __LINE__, #cond); } } while(0)
+#define CHECK_EQ(a, b) do { checkCount++; auto va_ = (a); auto vb_ = (b); if(!(va_ == vb_)){ checkFails++; \
+  fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s): %lld != %lld\n", __FILE__, __LINE__, #a, #b, \
+          (long long)va_, (long long)vb_); } } while(0)
+#define CHECK_STR(a, b) do { checkCount++; std::string va_ = (a), vb_ = (b); if(va_ != vb_){ checkFails++; \
+  fprintf(stderr, "%s:%d: CHECK_STR(%s)\n  got:  %s\n  want: %s\n", __FILE__, __LINE__, #a, \
+          va_.c_str(), vb_.c_str()); } } while(0)
+
+#define TEST(name) static void name()
+#define RUN(name) do { name(); } while(0)
+#define TEST_DONE() do { printf("%s: %d checks, %d falhas\n", __FILE__, checkCount, checkFails); \
+  return checkFails ? 1 : 0; } while(0)
@@ -0,0 +1,58 @@
+// Forma canônica e CRC32 dos passos (manifest/delta). Os mesmos vetores estão em
+// go-fleet/update_test.go: se um lado mudar sem o outro, o delta passa a mandar a macro inteira.
+#include "check.h"
+#include "macro.h"
+
+int   screenW = 1920, screenH = 1080;
+float countsPerPixel = 1.0f;
+int   actionDelay = 1500;
+JitterCfg jitter;
+void hidEmit(const HidOp&){}
+
+// Step como stepFromJson() entrega: defaults btn=left, delayMs=0, durMs=600, stepsN=1 (mínimo 1), jit=-1.
+static Step fromJsonDefaults(const char* type){
+  Step s; s.type=type; s.durMs=600; return s;
+}
+
+static Step vec(int i){
+  Step s;
+  switch(i){
+    case 0:  // {"type":"tap"}
+      s = fromJsonDefaults("tap"); break;
+    case 1:  // {"type":"tap","x":10,"y":-5,"button":"right","ms":250}
+      s = fromJsonDefaults("tap"); s.x=10; s.y=-5; s.btn="right"; s.delayMs=250; break;
+    case 2:  // {"type":"drag","x":1,"y":2,"x2":300,"y2":400,"delayMs":40,"ms":999,"durMs":900,"stepsN":0,"jit":0}
+      s = fromJsonDefaults("drag"); s.x=1; s.y=2; s.x2=300; s.y2=400; s.delayMs=40; s.durMs=900; s.jit=0; break;
+    default: // {"type":"type","text":"olá, mundo","delayMs":5}
+      s = fromJsonDefaults("type"); s.text="olá, mundo"; s.delayMs=5; break;
+  }
+  return s;
+}
+
+TEST(canonicalForm){
+  CHECK_STR(std::string(stepCanon(vec(0)).c_str()), "tap\x1f" "0\x1f" "0\x1f" "0\x1f" "0\x1f\x1f" "left\x1f" "0\x1f" "600\x1f" "1\x1f" "-1");
+  CHECK_STR(std::string(stepCanon(vec(3)).c_str()), "type\x1f" "0\x1f" "0\x1f" "0\x1f" "0\x1f" "olá, mundo\x1f" "left\x1f" "5\x1f" "600\x1f" "1\x1f" "-1");
+}
+
+TEST(stepVectors){
+  const char* want[4] = { "dedc1811", "0152cc35", "b2fdce4b", "2c9f73f2" };
+  for(int i=0;i<4;i++) CHECK_STR(std::string(hex32(stepCrc(vec(i))).c_str()), want[i]);
+}
+
+TEST(macroVectorIsChained){
+  Step v[4] = { vec(0), vec(1), vec(2), vec(3) };
+  CHECK_STR(std::string(hex32(macroCrc(v, 4)).c_str()), "bec468b9");
+  CHECK_STR(std::string(hex32(macroCrc(v, 0)).c_str()), "00000000");
+  // encadeado (zlib/crc32.Update): igual a um CRC só sobre "canon\n" concatenados
+  String all;
+  for(int i=0;i<4;i++){ all += stepCanon(v[i]); all += '\n'; }
+  CHECK_EQ(macroCrc(v, 4), crc32Update(0, (const uint8_t*)all.c_str(), all.length()));
+  CHECK_EQ(crc32Update(0, (const uint8_t*)"123456789", 9), 0xCBF43926u);  // check value do CRC-32/IEEE
+}
+
+int main(){
+  RUN(canonicalForm);
+  RUN(stepVectors);
+  RUN(macroVectorIsChained);
+  TEST_DONE();
+}
@@ -0,0 +1,100 @@
+// Cron do agendador (cronParse/cronNext) e pinos aceitos como gatilho GPIO. Hora local = UTC aqui.
+#include "check.h"
+#include "cron.h"
+#include <string>
+
+static time_t at(const char* s){   // "YYYY-MM-DD HH:MM"
+  struct tm t = {};
+  sscanf(s, "%d-%d-%d %d:%d", &t.tm_year, &t.tm_mon, &t.tm_mday, &t.tm_hour, &t.tm_min);
+  t.tm_year -= 1900; t.tm_mon -= 1; t.tm_isdst = -1;
+  return mktime(&t);
+}
+static std::string fmt(time_t v){
+  if(!v) return "never";
+  char b[24]; struct tm t; localtime_r(&v, &t);
+  strftime(b, sizeof b, "%Y-%m-%d %H:%M %a", &t);
+  return b;
+}
+static SchedEntry cron(const char* spec){
+  SchedEntry e; memset(&e, 0, sizeof(e));
+  CHECK(cronParse(spec, e));
+  return e;
+}
+static std::string next(const SchedEntry& e, const char* after){ return fmt(cronNext(e, at(after))); }
+
+TEST(quarterHoursOnWeekdayBusinessHours){
+  SchedEntry e = cron("*/15 8-18 * * 1-5");
+  CHECK_STR(next(e, "2026-10-14 10:07"), "2026-10-14 10:15 Wed");
+  CHECK_STR(next(e, "2026-10-14 10:15"), "2026-10-14 10:30 Wed");   // estritamente depois
+  CHECK_STR(next(e, "2026-10-14 18:45"), "2026-10-15 08:00 Thu");
+  CHECK_STR(next(e, "2026-10-16 18:50"), "2026-10-19 08:00 Mon");   // pula o fim de semana
+  CHECK_STR(next(e, "2026-10-18 03:00"), "2026-10-19 08:00 Mon");
+  // um dia útil inteiro: 11 horas x 4 disparos
+  int n = 0;
+  for(time_t t = at("2026-10-14 00:00"); (t = cronNext(e, t)) && t < at("2026-10-15 00:00"); ) n++;
+  CHECK_EQ(n, 44);
+}
+
+TEST(leapDay){
+  SchedEntry e = cron("0 0 29 2 *");
+  CHECK_STR(next(e, "2026-10-18 12:00"), "2028-02-29 00:00 Tue");
+  CHECK_STR(next(e, "2028-02-29 00:00"), "2032-02-29 00:00 Sun");
+}
+
+TEST(domDowOrRule){
+  // dom e dow restritos: dispara no dia 13 OU na sexta
+  SchedEntry e = cron("0 12 13 * 5");
+  CHECK_STR(next(e, "2026-12-08 00:00"), "2026-12-11 12:00 Fri");
+  CHECK_STR(next(e, "2026-12-11 12:00"), "2026-12-13 12:00 Sun");
+  CHECK_STR(next(e, "2026-12-13 12:00"), "2026-12-18 12:00 Fri");
+  // só um restrito: vale só ele (o "*" não amplia)
+  CHECK_STR(next(cron("0 12 13 * *"), "2026-12-08 00:00"), "2026-12-13 12:00 Sun");
+  CHECK_STR(next(cron("0 12 * * 5"), "2026-12-11 12:00"), "2026-12-18 12:00 Fri");
+  // dow 7 = domingo = 0
+  CHECK_STR(next(cron("30 9 * * 7"), "2026-10-14 00:00"), "2026-10-18 09:30 Sun");
+  CHECK_STR(next(cron("30 9 * * 0"), "2026-10-14 00:00"), "2026-10-18 09:30 Sun");
+}
+
+TEST(impossibleDateNeverFires){
+  SchedEntry e; memset(&e, 0, sizeof(e));
+  CHECK(!cronParse("0 0 31 2 *", e));     // recusado na config
+  CHECK(!cronParse("0 0 30,31 2 *", e));
+  CHECK(cronParse("0 0 31 2 1", e));      // com dow restrito vale o OU: toda segunda de fevereiro
+  CHECK_STR(next(e, "2026-10-18 00:00"), "2027-02-01 00:00 Mon");
+  // mesmo armado à força, cronNext desiste em vez de girar para sempre
+  SchedEntry raw = cron("0 0 28 2 *");
+  raw.mDom = 1UL<<31;
+  CHECK_STR(next(raw, "2026-10-18 00:00"), "never");
+}
+
+TEST(fieldSyntax){
+  uint64_t m;
+  CHECK(cronField("5/15", 0, 59, m));   CHECK_EQ(m, (1ULL<<5)|(1ULL<<20)|(1ULL<<35)|(1ULL<<50));
+  CHECK(cronField("1-3,7", 0, 59, m));  CHECK_EQ(m, 0x8EULL);
+  CHECK(!cronField("60", 0, 59, m));
+  CHECK(!cronField("5-2", 0, 59, m));
+  CHECK(!cronField("*/0", 0, 59, m));
+  CHECK(!cronField("a", 0, 59, m));
+  SchedEntry e;
+  CHECK(!cronParse("0 0 * *", e));
+  CHECK(!cronParse("0 24 * * *", e));
+}
+
+TEST(reservedGpios){
+  CHECK(!schedPinOk(19)); CHECK(!schedPinOk(20));   // USB D-/D+
+  CHECK(!schedPinOk(48));                           // LED RGB onboard
+  for(int p=22; p<=32; p++) CHECK(!schedPinOk(p));  // inexistentes + flash/PSRAM
+  CHECK(!schedPinOk(-1)); CHECK(!schedPinOk(49));
+  CHECK(schedPinOk(0)); CHECK(schedPinOk(4)); CHECK(schedPinOk(21)); CHECK(schedPinOk(47));
+}
+
+int main(){
+  setenv("TZ", "UTC0", 1); tzset();
+  RUN(quarterHoursOnWeekdayBusinessHours);
+  RUN(leapDay);
+  RUN(domDowOrRule);
+  RUN(impossibleDateNeverFires);
+  RUN(fieldSyntax);
+  RUN(reservedGpios);
+  TEST_DONE();
+}
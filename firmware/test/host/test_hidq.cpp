@@ -0,0 +1,183 @@
+// Fila SPSC de ops HID (HidRing): semântica, stress com duas threads e simulação em tempo virtual
+// do runner sob carga HTTP — com a fila do firmware a hidPump nunca fica sem op no meio do stream.
+#include "check.h"
+#include "hidq.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+static uint32_t rnd(uint32_t& s){ s^=s<<13; s^=s>>17; s^=s<<5; return s; }
+static HidOp op(uint8_t code, int16_t x=0, uint16_t ms=0){ return HidOp{code, 0, x, 0, ms}; }
+
+TEST(prefillAndUnderrunEpisodes){
+  HidRing<8,4> q;
+  HidOp o{};
+  q.begin();
+  for(int i=0;i<3;i++) CHECK(q.push(op(OP_MOVE,i)));
+  CHECK(!q.pop(o));                    // abaixo do prefill: não drena e não é underrun
+  CHECK_EQ(q.underruns, 0u);
+  CHECK(q.push(op(OP_MOVE,3)));
+  for(int i=0;i<4;i++){ CHECK(q.pop(o)); CHECK_EQ(o.x, i); }
+  CHECK(!q.pop(o)); CHECK(!q.pop(o)); CHECK(!q.pop(o));
+  CHECK_EQ(q.underruns, 1u);           // um episódio, não uma contagem por volta do consumidor
+  CHECK(q.push(op(OP_MOVE))); CHECK(q.pop(o)); CHECK(!q.pop(o));
+  CHECK_EQ(q.underruns, 2u);
+  q.end();
+  CHECK(!q.pop(o));
+  CHECK_EQ(q.underruns, 2u);           // stream fechado: vazio é o normal
+  CHECK_EQ(q.maxDepth, 4u);
+}
+
+TEST(fullAndProducerWake){
+  HidRing<8,2> q;
+  HidOp o{};
+  q.begin();
+  for(int i=0;i<8;i++) CHECK(q.push(op(OP_MOVE,i)));
+  CHECK(q.full()); CHECK(!q.push(op(OP_MOVE,99)));
+  q.prodWaiting = true;
+  int wakes = 0;
+  for(int i=0;i<8;i++){ CHECK(q.pop(o)); CHECK_EQ(o.x, i); if(q.wakeProducer()) wakes++; }
+  CHECK_EQ(wakes, 1);                  // acorda uma vez, ao chegar em meia fila
+  CHECK(!q.prodWaiting.load());
+}
+
+TEST(drainDiscardsEverything){
+  HidRing<8,1> q;
+  q.begin();
+  q.push(op(OP_MOVE)); q.push(op(OP_SYNC)); q.push(op(OP_WAIT,0,50));
+  int syncs = 0, n = 0;
+  q.drain([&](const HidOp& o){ n++; if(o.op==OP_SYNC) syncs++; });
+  CHECK_EQ(n, 3); CHECK_EQ(syncs, 1); CHECK_EQ(q.depth(), 0u);
+}
+
+// Notificação de task (ulTaskNotifyTake/xTaskNotifyGive) com contador, como no FreeRTOS.
+struct Notify {
+  std::mutex m; std::condition_variable cv; int count = 0;
+  void give(){ { std::lock_guard<std::mutex> l(m); count++; } cv.notify_one(); }
+  void take(int ms){
+    std::unique_lock<std::mutex> l(m);
+    cv.wait_for(l, std::chrono::milliseconds(ms), [&]{ return count>0; });
+    count = 0;
+  }
+};
+
+TEST(threadedStressKeepsOrder){
+  // mesmo handshake do main.cpp (hidPush/hidPump), com threads de verdade
+  static HidRing<64,8> q;
+  Notify prod, cons;
+  const uint32_t N = 300000;
+  bool ordered = true;
+  uint32_t got = 0;
+  std::thread c([&]{
+    HidOp o{};
+    while(got < N){
+      if(!q.pop(o)){
+        q.consIdle = true;
+        if(q.primed.load() && q.depth()){ q.consIdle = false; continue; }
+        cons.take(100);
+        q.consIdle = false;
+        continue;
+      }
+      if(q.wakeProducer()) prod.give();
+      const uint32_t v = (uint16_t)o.x | ((uint32_t)(uint16_t)o.y << 16);
+      if(v != got) ordered = false;
+      got++;
+    }
+  });
+  q.begin();
+  for(uint32_t i=0;i<N;i++){
+    HidOp o{OP_MOVE, 0, (int16_t)(i & 0xFFFF), (int16_t)(i >> 16), 0};
+    while(!q.push(o)){
+      q.prodWaiting = true;
+      q.primed = true; if(q.consIdle.load()) cons.give();
+      if(!q.full()){ q.prodWaiting = false; continue; }
+      prod.take(100);
+      q.prodWaiting = false;
+    }
+    if(q.primed.load() && q.consIdle.load()) cons.give();
+  }
+  q.end(); cons.give();
+  c.join();
+  CHECK_EQ(got, N);
+  CHECK(ordered);
+}
+
+// ===== Simulação em tempo virtual (µs) =====
+// Consumidor: cada op de report leva um intervalo de polling USB (1 ms); WAIT leva o próprio ms.
+// Produtor: ~5 µs por op, mas fica parado em janelas de "HTTP" (handler/Wi-Fi no mesmo core) de até 40 ms.
+// Fila cheia: dorme até wakeProducer() (+ latência de troca de contexto), como o runner no firmware.
+struct SimResult { uint32_t underruns, producerWakes, maxDepth; };
+
+static std::vector<HidOp> macroOps(){
+  std::vector<HidOp> v;
+  for(int s=0;s<400;s++){
+    v.push_back(op(OP_STEP, s)); v.push_back(HidOp{OP_PHASE, PH_MOVE, 1, 0, 0});
+    for(int i=0;i<12;i++) v.push_back(op(OP_MOVE, 40));
+    v.push_back(HidOp{OP_PHASE, PH_MOVE, 0, 0, 0});
+    v.push_back(op(OP_PRESS)); v.push_back(op(OP_WAIT, 0, 20)); v.push_back(op(OP_RELEASE));
+    for(int k=0;k<(s%3)*6;k++){ v.push_back(op(OP_KPRESS)); v.push_back(op(OP_WAIT,0,3)); v.push_back(op(OP_KRELEASE)); }
+    if(s%5==0) v.push_back(op(OP_WAIT, 0, 80));  // delay pós-ação curto
+  }
+  return v;
+}
+
+template<uint32_t CAP, uint32_t PREFILL>
+static SimResult simulate(const std::vector<HidOp>& ops){
+  HidRing<CAP,PREFILL> q;
+  const uint64_t NEVER = ~0ULL, SWITCH_US = 20, PUSH_US = 5;
+  // janelas de carga HTTP: começam a cada 20–60 ms e duram 5–40 ms
+  std::vector<std::pair<uint64_t,uint64_t>> stalls;
+  uint32_t r = 12345;
+  for(uint64_t t = 10000; t < 60000000; ){
+    const uint64_t len = 5000 + rnd(r) % 35000;
+    stalls.push_back({t, t+len});
+    t += len + 20000 + rnd(r) % 40000;
+  }
+  size_t si = 0, idx = 0;
+  uint64_t tProd = 0, tCons = 0;
+  bool ended = false;
+  uint32_t wakes = 0;
+  q.begin();
+  while(!(ended && q.depth()==0)){
+    if(tProd != NEVER && tProd <= tCons){
+      while(si < stalls.size() && stalls[si].second <= tProd) si++;
+      if(si < stalls.size() && stalls[si].first <= tProd){ tProd = stalls[si].second; continue; }
+      if(idx == ops.size()){ q.end(); ended = true; tProd = NEVER; continue; }
+      if(q.push(ops[idx])){ idx++; tProd += PUSH_US; }
+      else { q.prodWaiting = true; q.primed = true; tProd = NEVER; }
+      continue;
+    }
+    HidOp o{};
+    if(!q.pop(o)){ tCons = (tProd==NEVER ? tCons : tProd) + SWITCH_US; continue; }
+    if(q.wakeProducer()){ wakes++; tProd = tCons + SWITCH_US; }
+    switch(o.op){
+      case OP_MOVE: case OP_PRESS: case OP_RELEASE: case OP_KPRESS: case OP_KRELEASE: tCons += 1000; break;
+      case OP_WAIT: tCons += (uint64_t)o.ms*1000; break;
+      default: break;
+    }
+  }
+  return SimResult{q.underruns, wakes, q.maxDepth};
+}
+
+TEST(noUnderrunsUnderHttpLoad){
+  const std::vector<HidOp> ops = macroOps();
+  SimResult fw = simulate<256,32>(ops);          // HIDQ_CAP/HIDQ_PREFILL do firmware
+  CHECK_EQ(fw.underruns, 0u);
+  CHECK_EQ(fw.maxDepth, 256u);                   // o produtor chegou a encher e dormir
+  CHECK(fw.producerWakes > 0);
+  CHECK(fw.producerWakes <= ops.size()/128 + 1);  // acorda em rajadas de meia fila
+  // controle: a mesma carga numa fila minúscula passa fome — o teste enxerga underruns
+  SimResult tiny = simulate<16,4>(ops);
+  CHECK(tiny.underruns > 0);
+}
+
+int main(){
+  RUN(prefillAndUnderrunEpisodes);
+  RUN(fullAndProducerWake);
+  RUN(drainDiscardsEverything);
+  RUN(threadedStressKeepsOrder);
+  RUN(noUnderrunsUnderHttpLoad);
+  TEST_DONE();
+}
@@ -0,0 +1,153 @@
+// Jitter compilado (jitCompile/stepJit) na simulação de host: mesma seed e mesmo loop = mesmo stream
+// de ops HID; seed ou loop diferentes mudam o stream; todo sorteio fica dentro de delayPct/hold/char/posPx.
+#include "check.h"
+#include "macro.h"
+#include <vector>
+
+int   screenW = 1920, screenH = 1080;
+float countsPerPixel = 1.0f;
+int   actionDelay = 1500;
+JitterCfg jitter;
+
+static std::vector<HidOp> rec;
+void hidEmit(const HidOp& o){ rec.push_back(o); }
+
+static std::vector<Step> macro(){
+  std::vector<Step> v(9);
+  v[0].type="tap";   v[0].x=300; v[0].y=200; v[0].delayMs=400;
+  v[1].type="tap";   v[1].x=300; v[1].y=200; v[1].jit=0;                       // sem jitter, delay global
+  v[2].type="drag";  v[2].x=10; v[2].y=10; v[2].x2=400; v[2].y2=300; v[2].durMs=80; v[2].stepsN=8; v[2].delayMs=250;
+  v[3].type="type";  v[3].text="hello world"; v[3].delayMs=120;
+  v[4].type="key";   v[4].text="ctrl+s"; v[4].delayMs=90; v[4].jit=30;          // ±30% próprio
+  v[5].type="wait";  v[5].delayMs=1000;
+  v[6].type="consumer"; v[6].text="mute"; v[6].delayMs=60;
+  v[7].type="scroll"; v[7].y=360; v[7].stepsN=3; v[7].durMs=30; v[7].delayMs=70;
+  v[8].type="pinch"; v[8].x=900; v[8].y=500; v[8].x2=100; v[8].y2=400; v[8].durMs=64; v[8].delayMs=50;
+  return v;
+}
+
+// Um loop do runner: compila o jitter do loop e executa os passos.
+static std::vector<HidOp> runLoop(const std::vector<Step>& v, uint32_t loopIdx, std::vector<StepJit>* jOut = nullptr){
+  std::vector<StepJit> j(v.size());
+  jitCompile(v.data(), (int)v.size(), loopIdx, j.data());
+  rec.clear();
+  cursorForget();
+  for(size_t i=0;i<v.size();i++){ hidStep((int)i+1); execStep(v[i], j[i]); }
+  if(jOut) *jOut = j;
+  return rec;
+}
+
+static bool same(const std::vector<HidOp>& a, const std::vector<HidOp>& b){
+  if(a.size()!=b.size()) return false;
+  for(size_t i=0;i<a.size();i++)
+    if(a[i].op!=b[i].op || a[i].a!=b[i].a || a[i].x!=b[i].x || a[i].y!=b[i].y || a[i].ms!=b[i].ms) return false;
+  return true;
+}
+
+static void config(uint32_t seed, uint8_t dist){
+  jitter = JitterCfg();
+  jitter.on = true; jitter.seed = seed; jitter.dist = dist;
+  jitter.delayPct = 20; jitter.holdMin = 20; jitter.holdMax = 60;
+  jitter.charMin = 3; jitter.charMax = 15; jitter.posPx = 4;
+}
+
+TEST(sameSeedSameRun){
+  const std::vector<Step> v = macro();
+  for(uint8_t dist : { JD_UNIFORM, JD_TRI }){
+    config(42, dist);
+    const std::vector<HidOp> a = runLoop(v, 0), b = runLoop(v, 0);
+    CHECK(a.size() > 100);
+    CHECK(same(a, b));
+    CHECK(same(runLoop(v, 7), runLoop(v, 7)));
+    CHECK(!same(a, runLoop(v, 1)));            // cada loop sorteia de novo
+    config(43, dist);
+    CHECK(!same(a, runLoop(v, 0)));            // outra seed
+    config(42, dist == JD_UNIFORM ? JD_TRI : JD_UNIFORM);
+    CHECK(!same(a, runLoop(v, 0)));            // outra distribuição
+  }
+  // seed 0 não trava o PRNG (xorshift32 com estado 0 só devolve 0)
+  config(0, JD_UNIFORM);
+  CHECK(!same(runLoop(v, 0), runLoop(v, 1)));
+}
+
+TEST(offMeansNoJitter){
+  const std::vector<Step> v = macro();
+  config(42, JD_UNIFORM);
+  jitter.on = false;
+  std::vector<StepJit> j;
+  const std::vector<HidOp> off = runLoop(v, 3, &j);
+  for(const StepJit& s : j){
+    CHECK_EQ(s.dx, 0); CHECK_EQ(s.dy, 0); CHECK_EQ(s.dx2, 0); CHECK_EQ(s.dy2, 0);
+    CHECK_EQ(s.dDelay, 0); CHECK_EQ(s.holdMs, 0); CHECK_EQ(s.charSeed, 0u);
+  }
+  rec.clear(); cursorForget();
+  for(size_t i=0;i<v.size();i++){ hidStep((int)i+1); execStep(v[i], NO_JIT); }
+  CHECK(same(off, rec));
+}
+
+// Limites dos sorteios, nos StepJit e no que de fato sai na fila.
+TEST(drawsStayInRange){
+  const std::vector<Step> v = macro();
+  for(uint8_t dist : { JD_UNIFORM, JD_TRI }){
+    config(7, dist);
+    int minPos = 99, maxPos = -99, minHold = 999, maxHold = 0, minChar = 999, maxChar = 0;
+    for(uint32_t loop = 0; loop < 300; loop++){
+      std::vector<StepJit> j;
+      const std::vector<HidOp> ops = runLoop(v, loop, &j);
+      for(size_t i=0;i<v.size();i++){
+        const StepJit& s = j[i];
+        if(v[i].jit==0){ CHECK_EQ(s.dDelay, 0); CHECK_EQ(s.dx, 0); CHECK_EQ(s.holdMs, 0); continue; }
+        for(int d : { (int)s.dx, (int)s.dy, (int)s.dx2, (int)s.dy2 }){
+          CHECK(d >= -jitter.posPx && d <= jitter.posPx); minPos = min(minPos, d); maxPos = max(maxPos, d);
+        }
+        const int pct = v[i].jit>0 ? v[i].jit : jitter.delayPct;
+        const int base = v[i].delayMs>0 ? v[i].delayMs : actionDelay;
+        CHECK(abs(s.dDelay) <= base*pct/100);
+        CHECK(s.holdMs >= jitter.holdMin && s.holdMs <= jitter.holdMax);
+        minHold = min(minHold, (int)s.holdMs); maxHold = max(maxHold, (int)s.holdMs);
+        CHECK(s.charSeed & 1);
+      }
+      // no stream: delay pós-ação, hold do clique e cadência de digitação
+      int phase = -1, step = 0; long delay = 0;
+      bool pressed = false; int hold = 0;
+      for(const HidOp& o : ops){
+        if(o.op==OP_STEP){ step = o.x; continue; }
+        if(o.op==OP_PHASE){
+          if(o.x){ phase = o.a; delay = 0; continue; }
+          if(phase==PH_DELAY){
+            const Step& st = v[step-1];
+            const int pct = st.jit==0 ? 0 : st.jit>0 ? st.jit : jitter.delayPct;
+            const int base = st.delayMs>0 ? st.delayMs : actionDelay;
+            CHECK(delay >= base - base*pct/100 && delay <= base + base*pct/100);
+          }
+          phase = -1; continue;
+        }
+        if(o.op==OP_WAIT && phase==PH_DELAY) delay += o.ms;
+        if(o.op==OP_WAIT && phase==PH_TEXT){
+          CHECK(o.ms >= jitter.charMin && o.ms <= jitter.charMax);
+          minChar = min(minChar, (int)o.ms); maxChar = max(maxChar, (int)o.ms);
+        }
+        if(phase==PH_BUTTON && v[step-1].type=="tap"){
+          if(o.op==OP_PRESS){ pressed = true; hold = 0; }
+          else if(o.op==OP_WAIT && pressed) hold += o.ms;
+          else if(o.op==OP_RELEASE){
+            pressed = false;
+            if(v[step-1].jit==0) CHECK_EQ(hold, 25);
+            else CHECK(hold >= jitter.holdMin && hold <= jitter.holdMax);
+          }
+        }
+      }
+    }
+    // 300 loops cobrem a faixa inteira (o sorteio não está preso num canto)
+    CHECK_EQ(minPos, -jitter.posPx); CHECK_EQ(maxPos, jitter.posPx);
+    CHECK_EQ(minHold, jitter.holdMin); CHECK_EQ(maxHold, jitter.holdMax);
+    CHECK_EQ(minChar, jitter.charMin); CHECK_EQ(maxChar, jitter.charMax);
+  }
+}
+
+int main(){
+  RUN(sameSeedSameRun);
+  RUN(offMeansNoJitter);
+  RUN(drawsStayInRange);
+  TEST_DONE();
+}
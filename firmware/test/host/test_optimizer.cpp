@@ -0,0 +1,180 @@
+// Golden tests do otimizador: o stream de ops que execStep emite para a macro otimizada tem que ser
+// semanticamente igual ao da original — mesmos reports observáveis (botões, teclas, toque, roda,
+// consumer) nas mesmas posições do cursor e com o mesmo tempo de delay entre eles.
+#include "check.h"
+#include "macro.h"
+#include <string>
+#include <vector>
+
+int   screenW = 1920, screenH = 1080;
+float countsPerPixel = 1.0f;
+int   actionDelay = 1500;
+JitterCfg jitter;
+
+static std::vector<HidOp> rec;
+void hidEmit(const HidOp& o){ rec.push_back(o); }
+
+static std::vector<HidOp> record(const std::vector<Step>& v){
+  rec.clear();
+  cursorForget();
+  for(const Step& s : v) execStep(s, NO_JIT);
+  return rec;
+}
+
+// Visão semântica: MOVEs viram posição (contagens; o host prende em 0, que é o que o homing usa),
+// WAITs dentro de PH_DELAY viram "+ms" antes do próximo evento; o resto do tempo é custo de HID.
+struct Ev { std::string what; long idleMs; };
+static std::vector<Ev> semantic(const std::vector<HidOp>& ops){
+  std::vector<Ev> out;
+  long x=0, y=0, idle=0; int phase=-1; char b[64];
+  for(const HidOp& o : ops){
+    switch(o.op){
+      case OP_MOVE:     x = max(0L, x+o.x); y = max(0L, y+o.y); continue;
+      case OP_PHASE:    phase = o.x ? o.a : -1; continue;
+      case OP_WAIT:     if(phase==PH_DELAY) idle += o.ms; continue;
+      case OP_STEP: case OP_SYNC: continue;
+      case OP_PRESS:    snprintf(b, sizeof b, "P%u@%ld,%ld", o.a, x, y); break;
+      case OP_RELEASE:  snprintf(b, sizeof b, "R%u@%ld,%ld", o.a, x, y); break;
+      case OP_KPRESS:   snprintf(b, sizeof b, "K%u", o.a); break;
+      case OP_KRELEASE: snprintf(b, sizeof b, "k%u", o.a); break;
+      case OP_TOUCH:    snprintf(b, sizeof b, "T%u:%d,%d,%u", o.a, o.x, o.y, o.ms); break;
+      case OP_TFRAME:   snprintf(b, sizeof b, "F%u", o.a); break;
+      case OP_WHEEL:    snprintf(b, sizeof b, "W%d,%d", o.x, o.y); break;
+      case OP_CPRESS:   snprintf(b, sizeof b, "C%04x", (unsigned)(uint16_t)o.x); break;
+      case OP_CRELEASE: snprintf(b, sizeof b, "c"); break;
+      default:          snprintf(b, sizeof b, "?%u", o.op); break;
+    }
+    out.push_back({b, idle}); idle = 0;
+  }
+  if(idle) out.push_back({"end", idle});
+  return out;
+}
+
+static std::string golden(const std::vector<Ev>& ev){
+  std::string s;
+  for(const Ev& e : ev){
+    if(!s.empty()) s += ' ';
+    if(e.idleMs) s += "+" + std::to_string(e.idleMs) + " ";
+    s += e.what;
+  }
+  return s;
+}
+
+static int countOps(const std::vector<HidOp>& ops, uint8_t op){
+  int n=0; for(const HidOp& o : ops) if(o.op==op) n++; return n;
+}
+
+// orig x otimizada: mesmos eventos; o delay antes de cada evento pode encurtar no máximo tolMs
+// (junção de TYPEs) e nunca crescer. O otimizado não pode emitir mais reports.
+static void checkEquivalent(std::vector<Step> orig, long tolMs, int expectN){
+  std::vector<Step> opt = orig;
+  int n = optimizeSteps(opt.data(), (int)opt.size());
+  opt.resize(n);
+  if(expectN >= 0) CHECK_EQ(n, expectN);
+  std::vector<HidOp> ra = record(orig), rb = record(opt);
+  std::vector<Ev> a = semantic(ra), b = semantic(rb);
+  CHECK_EQ(a.size(), b.size());
+  bool same = a.size()==b.size();
+  for(size_t i=0; same && i<a.size(); i++){
+    long d = a[i].idleMs - b[i].idleMs;
+    if(a[i].what != b[i].what || d < 0 || d > tolMs) same = false;
+  }
+  if(!same) CHECK_STR(golden(b), golden(a));
+  CHECK(countOps(rb, OP_MOVE) <= countOps(ra, OP_MOVE));
+}
+
+static Step mk(const char* type, int x=0, int y=0, int delayMs=0){
+  Step s; s.type=type; s.x=x; s.y=y; s.delayMs=delayMs; s.durMs=600; return s;
+}
+static Step txt(const char* type, const char* text, int delayMs=0){
+  Step s=mk(type); s.text=text; s.delayMs=delayMs; return s;
+}
+
+TEST(goldenRepeatedTap){
+  // 2º TAP no mesmo ponto não re-homa (posição lembrada na execução), cliques no mesmo lugar
+  std::vector<HidOp> ops = record({ mk("tap",10,5,100), mk("tap",10,5,100) });
+  CHECK_STR(golden(semantic(ops)), "P1@10,5 R1@10,5 +100 P1@10,5 R1@10,5 +100 end");
+  CHECK_EQ(countOps(ops, OP_MOVE), 30 + 1);   // um homing (30 x -127) + 1 move até (10,5)
+}
+
+TEST(waitNotFoldedIntoGlobalDelay){
+  // type "user" -> wait 3000 -> type "pass": antes o wait sumia na junção dos TYPEs
+  std::vector<Step> m = { txt("type","user"), mk("wait",0,0,3000), txt("type","pass") };
+  checkEquivalent(m, 0, 3);
+  std::vector<Ev> ev = semantic(record(m));
+  for(const Ev& e : ev) if(e.what=="K112"){ CHECK_EQ(e.idleMs, 1500L + 3000L); break; }  // 'p'
+}
+
+TEST(explicitWaitsFold){
+  std::vector<Step> m = { mk("tap",40,40,200), mk("wait",0,0,300), mk("wait",0,0,100) };
+  checkEquivalent(m, 0, 1);
+  std::vector<Step> o = m; optimizeSteps(o.data(), (int)o.size());
+  CHECK_EQ(o[0].delayMs, 600);
+}
+
+TEST(globalDelayStaysLive){
+  // otimiza com actionDelay=1500 e roda com 200: delayMs==0 continua sendo "global"
+  std::vector<Step> m = { mk("tap",5,5), mk("wait"), mk("tap",9,9,50), mk("wait",0,0,70),
+                          txt("type","a"), mk("wait") };
+  std::vector<Step> o = m;
+  o.resize(optimizeSteps(o.data(), (int)o.size()));
+  actionDelay = 200;
+  CHECK_STR(golden(semantic(record(o))), golden(semantic(record(m))));
+  actionDelay = 1500;
+}
+
+TEST(typeMergeOnlyAcrossCadenceGap){
+  std::vector<Step> small = { txt("type","ab",TYPE_MERGE_GAP_MS), txt("type","cd",700) };
+  checkEquivalent(small, TYPE_MERGE_GAP_MS, 1);
+  std::vector<Step> o = small; optimizeSteps(o.data(), (int)o.size());
+  CHECK_STR(std::string(o[0].text.c_str()), "abcd");
+  CHECK_EQ(o[0].delayMs, 700);
+
+  checkEquivalent({ txt("type","ab"), txt("type","cd") }, 0, 2);        // delay global: não junta
+  checkEquivalent({ txt("type","ab",400), txt("type","cd") }, 0, 2);    // delay real: não junta
+}
+
+TEST(dragStepsClamped){
+  Step d = mk("drag",0,0,20); d.x2=3; d.y2=0; d.stepsN=50; d.durMs=100;
+  std::vector<Step> o = { d };
+  optimizeSteps(o.data(), 1);
+  CHECK_EQ(o[0].stepsN, 3);
+  checkEquivalent({ d, mk("tap",7,7,10) }, 0, 2);
+}
+
+TEST(cursorTrackedAtRunTime){
+  auto homes = [](std::vector<Step> m){ return countOps(record(m), OP_MOVE) > 31; };
+  Step drag = mk("drag",10,10); drag.x2=20; drag.y2=20; drag.stepsN=2;
+  Step touch = txt("touch","100,100"); Step pinch = mk("pinch",300,300); pinch.x2=50; pinch.y2=100;
+  Step scroll = mk("scroll",0,120); Step cons = txt("consumer","volup");
+  // neutros para o ponteiro: 2º TAP não re-homa
+  CHECK(!homes({ mk("tap",10,10), txt("type","x"), txt("key","ctrl+c"), mk("wait"), scroll, cons, mk("tap",10,10) }));
+  // drag, touch e pinch movem o ponteiro: re-homa
+  CHECK(homes({ mk("tap",10,10), drag,  mk("tap",10,10) }));
+  CHECK(homes({ mk("tap",10,10), touch, mk("tap",10,10) }));
+  CHECK(homes({ mk("tap",10,10), pinch, mk("tap",10,10) }));
+  CHECK(homes({ mk("tap",10,10), mk("tap",11,10) }));
+}
+
+TEST(editsAfterOptimizeStaySafe){
+  // nada derivado fica gravado: reordenar a macro otimizada equivale a reordenar a original
+  Step drag = mk("drag",10,10,30); drag.x2=200; drag.y2=10; drag.stepsN=5;
+  std::vector<Step> m = { mk("tap",10,10,30), mk("tap",10,10,30), drag };
+  std::vector<Step> o = m;
+  o.resize(optimizeSteps(o.data(), (int)o.size()));
+  std::swap(m[1], m[2]); std::swap(o[1], o[2]);
+  CHECK_STR(golden(semantic(record(o))), golden(semantic(record(m))));
+  CHECK_STR(golden(semantic(record(m))).substr(0, 31), "P1@10,10 R1@10,10 +30 P1@10,10 ");
+}
+
+int main(){
+  RUN(goldenRepeatedTap);
+  RUN(waitNotFoldedIntoGlobalDelay);
+  RUN(explicitWaitsFold);
+  RUN(globalDelayStaysLive);
+  RUN(typeMergeOnlyAcrossCadenceGap);
+  RUN(dragStepsClamped);
+  RUN(cursorTrackedAtRunTime);
+  RUN(editsAfterOptimizeStaySafe);
+  TEST_DONE();
+}
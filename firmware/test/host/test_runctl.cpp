@@ -0,0 +1,59 @@
+// Início armado do fleet do lado do firmware: admissão de /runLoop?at= e a espera do runner.
+// O go-fleet testa o protocolo contra devices falsos; aqui é a lógica que roda na placa.
+#include "check.h"
+#include "runctl.h"
+#include <string.h>
+
+static uint32_t rnd(uint32_t& s){ s^=s<<13; s^=s>>17; s^=s<<5; return s; }
+
+TEST(admission){
+  const int64_t now = 5000000;
+  CHECK(runAdmit(0, now, false, false) == nullptr);            // sem at: começa já
+  CHECK(runAdmit(0, now, true, false) == nullptr);             // sem at com loop rodando: recomeça a contagem, como antes
+  CHECK(runAdmit(now + 500000, now, false, false) == nullptr);
+  CHECK(!strcmp(runAdmit(now, now, false, false), "at in the past"));
+  CHECK(!strcmp(runAdmit(now - 1, now, false, false), "at in the past"));
+  // em execução ou dry-run: at só seria visto no fim do loop atual -> recusa (fleet: não armado)
+  CHECK(!strcmp(runAdmit(now + 500000, now, true, false), "running"));
+  CHECK(!strcmp(runAdmit(now + 500000, now, false, true), "running"));
+  CHECK(!strcmp(runAdmit(now + 500000, now, true, true), "running"));
+}
+
+TEST(sleepThenSpin){
+  CHECK_EQ(armSleepMs(1000, 1000), 0u);
+  CHECK_EQ(armSleepMs(1000, 2000), 0u);                        // já passou: gira (sai na hora)
+  CHECK_EQ(armSleepMs(3000, 0), 0u);                           // dentro da janela de giro
+  CHECK_EQ(armSleepMs(3001, 0), 1u);
+  CHECK_EQ(armSleepMs(502000, 0), 500u);
+  // dormir ms e acordar até um tick (1 ms) atrasado nunca passa de at
+  for(int64_t rem = 0; rem < 50000; rem += 7){
+    const uint32_t ms = armSleepMs(rem, 0);
+    CHECK((int64_t)ms*1000 + 1000 <= (rem > ARM_SPIN_US ? rem : ARM_SPIN_US + 1000));
+  }
+}
+
+// Runner simulado: dorme o que armSleepMs manda (acorda 0–999 µs atrasado, tick/preempção),
+// repete, e gira até at. Placas com relógios deslocados armadas no mesmo instante do host.
+TEST(boardsStartAligned){
+  const int64_t offsets[] = { 3000000, -7000000, 123456, 0 };
+  const int64_t hostAt = 10000000;
+  uint32_t r = 99;
+  for(int64_t off : offsets){
+    const int64_t at = hostAt + off;
+    int64_t now = 9500000 + off;                                // pedido chega 500 ms antes
+    CHECK(runAdmit(at, now, false, false) == nullptr);
+    int sleeps = 0;
+    while(uint32_t ms = armSleepMs(at, now)){ now += (int64_t)ms*1000 + rnd(r)%1000; sleeps++; CHECK(now < at); }
+    CHECK(sleeps >= 1 && sleeps <= 4);                          // dorme em poucas rajadas, não por tick
+    CHECK(at - now <= ARM_SPIN_US + 1000);                      // giro curto
+    while(now < at) now += 1;                                   // giro
+    CHECK_EQ(now - off, hostAt);
+  }
+}
+
+int main(){
+  RUN(admission);
+  RUN(sleepThenSpin);
+  RUN(boardsStartAligned);
+  TEST_DONE();
+}
@@ -0,0 +1,135 @@
+// Scroll e consumer na simulação de host: scrollBurst reparte as unidades sem perder nenhuma e sem
+// estourar ±32767 por report, no tempo pedido; wheelUnits (host em notches) guarda o resto entre
+// reports; stepInvalid recusa o que execStep pularia em silêncio.
+#include "check.h"
+#include "macro.h"
+#include <vector>
+
+int   screenW = 1920, screenH = 1080;
+float countsPerPixel = 1.0f;
+int   actionDelay = 0;
+JitterCfg jitter;
+
+static std::vector<HidOp> rec;
+void hidEmit(const HidOp& o){ rec.push_back(o); }
+
+struct Burst { long v = 0, h = 0; int reports = 0, waits = 0; long waitMs = 0; bool inPhase = true, closed = false; };
+static Burst burst(long v, long h, int reports, int durMs){
+  rec.clear();
+  scrollBurst(v, h, reports, durMs);
+  Burst b; int phase = -1;
+  for(const HidOp& o : rec){
+    if(o.op==OP_PHASE){ if(o.x) phase = o.a; else { b.closed = true; phase = -1; } continue; }
+    if(phase!=PH_SCROLL) b.inPhase = false;
+    if(o.op==OP_WHEEL){
+      b.reports++; b.v += o.y; b.h += o.x;
+      CHECK(o.y >= -32767 && o.y <= 32767);
+      CHECK(o.x >= -32767 && o.x <= 32767);
+    }
+    if(o.op==OP_WAIT){ b.waits++; b.waitMs += o.ms; }
+  }
+  return b;
+}
+
+TEST(unitsSurviveSplitting){
+  Burst b = burst(360, 0, 3, 30);
+  CHECK_EQ(b.v, 360L); CHECK_EQ(b.reports, 3);
+  CHECK(b.inPhase && b.closed);
+  for(const HidOp& o : rec) if(o.op==OP_WHEEL) CHECK_EQ((int)o.y, 120);
+  // divisões que não fecham: cada report fica a no máximo 1 unidade da média, soma exata
+  const long vs[] = { 100, -50, 1, -1, 7, 119, -241, 32767, -32767 };
+  for(long v : vs) for(long h : vs) for(int n = 1; n <= 9; n++){
+    b = burst(v, h, n, 0);
+    CHECK_EQ(b.v, v); CHECK_EQ(b.h, h); CHECK_EQ(b.reports, n);
+    CHECK_EQ(b.waits, 0);
+    for(const HidOp& o : rec) if(o.op==OP_WHEEL){
+      CHECK(labs(o.y*(long)n - v) < n); CHECK(labs(o.x*(long)n - h) < n);
+    }
+  }
+  b = burst(0, 0, 5, 100);
+  CHECK(rec.empty());
+}
+
+TEST(bigScrollSplitsAt32767){
+  struct { long v, h; int reports, want; } const T[] = {
+    { 32768, 0, 1, 2 }, { -32768, 0, 1, 2 }, { 100000, -70000, 1, 4 }, { 0, -200000, 3, 7 },
+    { 32767L*5 + 1, 32767L*5, 2, 6 }, { 65534, 0, 10, 10 },   // stepsN já basta: não mexe
+  };
+  for(const auto& t : T){
+    Burst b = burst(t.v, t.h, t.reports, 0);
+    CHECK_EQ(b.v, t.v); CHECK_EQ(b.h, t.h);
+    CHECK_EQ(b.reports, t.want);
+  }
+}
+
+TEST(timingFitsDuration){
+  // stepsN reports ao longo de durMs: uma espera de durMs/stepsN entre reports, nenhuma depois
+  Burst b = burst(1200, 0, 10, 100);
+  CHECK_EQ(b.waits, 9); CHECK_EQ(b.waitMs, 90L);
+  int wheels = 0;
+  for(size_t i=0;i<rec.size();i++){
+    if(rec[i].op==OP_WHEEL) wheels++;
+    if(rec[i].op==OP_WAIT){ CHECK_EQ((int)rec[i].ms, 10); CHECK(rec[i-1].op==OP_WHEEL); }
+  }
+  CHECK_EQ(wheels, 10);
+  for(int dur : { 0, 1, 7, 30, 99, 1000 }) for(int n = 1; n <= 12; n++){
+    b = burst(-360, 240, n, dur);
+    CHECK(b.waitMs <= dur);
+    CHECK_EQ(b.waits, (n>1 && dur>=n) ? n-1 : 0);
+  }
+  // o split forçado por ±32767 reparte o mesmo durMs
+  b = burst(200000, 0, 1, 70);
+  CHECK_EQ(b.reports, 7); CHECK_EQ(b.waitMs, 60L);
+}
+
+TEST(notchRemainderCarriesOver){
+  // host sem Resolution Multiplier: 40 unidades por report = 1 notch a cada 3 reports
+  int acc = 0, notches = 0;
+  for(int i=1;i<=30;i++){
+    const int16_t n = wheelUnits(40, false, acc);
+    CHECK(n==0 || n==1);
+    if(i%3) CHECK_EQ((int)n, 0); else CHECK_EQ((int)n, 1);
+    notches += n;
+    CHECK_EQ(notches*WHEEL_DELTA + acc, i*40);
+  }
+  // sentido oposto desconta o resto; nada se perde no caminho
+  acc = 0; notches = 0; long sent = 0;
+  const int16_t seq[] = { 50, 50, -30, 200, -400, 7, 113, -120, 32767, -32767, 1 };
+  for(int16_t u : seq){
+    notches += wheelUnits(u, false, acc); sent += u;
+    CHECK(acc > -WHEEL_DELTA && acc < WHEEL_DELTA);
+    CHECK_EQ(notches*(long)WHEEL_DELTA + acc, sent);
+  }
+  // alta resolução: passa direto e não mexe no resto
+  acc = 17;
+  CHECK_EQ((int)wheelUnits(-241, true, acc), -241); CHECK_EQ(acc, 17);
+  // scrollBurst + host em notches: 3 notches em 10 reports saem inteiros
+  rec.clear(); acc = 0; notches = 0;
+  scrollBurst(360, 0, 10, 0);
+  for(const HidOp& o : rec) if(o.op==OP_WHEEL) notches += wheelUnits(o.y, false, acc);
+  CHECK_EQ(notches, 3); CHECK_EQ(acc, 0);
+}
+
+TEST(stepValidation){
+  Step s; s.type = "consumer";
+  for(const char* ok : { "volup", "mute", " Volume_Up ", "browser_back", "0x00E9", "0xe2" }){ s.text = ok; CHECK(stepInvalid(s) == nullptr); }
+  for(const char* bad : { "", "volume-up", "louder", "0x", "0x0000", "0xZZ" }){ s.text = bad; CHECK(stepInvalid(s) != nullptr); }
+  s.type = "touch";
+  for(const char* ok : { "800,600>800,300", "800,600>800,300;900,600>900,300", "10,10" }){ s.text = ok; CHECK(stepInvalid(s) == nullptr); }
+  for(const char* bad : { "", "abc", "10", "10,", "10,10>x", "1,1;2,2;3,3;4,4;5,5;6,6;7,7;8,8;9,9;10,10;11,11" }){ s.text = bad; CHECK(stepInvalid(s) != nullptr); }
+  // os outros tipos não dependem de text
+  for(const char* t : { "tap", "drag", "type", "key", "wait", "scroll", "pinch" }){ s.type = t; s.text = "abc"; CHECK(stepInvalid(s) == nullptr); }
+  // o que passa na validação emite alguma coisa em execStep
+  s.type = "consumer"; s.text = "mute"; rec.clear(); execStep(s, NO_JIT);
+  bool press = false; for(const HidOp& o : rec) if(o.op==OP_CPRESS) press = true;
+  CHECK(press);
+}
+
+int main(){
+  RUN(unitsSurviveSplitting);
+  RUN(bigScrollSplitsAt32767);
+  RUN(timingFitsDuration);
+  RUN(notchRemainderCarriesOver);
+  RUN(stepValidation);
+  TEST_DONE();
+}
@@ -0,0 +1,232 @@
+// Digitizer multi-touch e roda: o descritor (bytes) bate com os structs enviados, e o agendamento
+// de contatos dos gestos (touch/pinch) — encostar, andar, levantar — sai como esperado.
+#include "check.h"
+#include "macro.h"
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+int   screenW = 1920, screenH = 1080;
+float countsPerPixel = 1.0f;
+int   actionDelay = 0;
+JitterCfg jitter;
+
+static std::vector<HidOp> rec;
+void hidEmit(const HidOp& o){ rec.push_back(o); }
+
+// ===== Parser mínimo de report descriptor (itens curtos) =====
+struct Field {
+  uint8_t  rid; char kind;        // 'I' input, 'F' feature
+  uint16_t page, usage;
+  uint32_t bit, size;
+  int32_t  lmin, lmax;
+  bool     cnst;
+};
+struct Parsed { std::vector<Field> f; int depth = 0, maxDepth = 0, apps = 0; bool ok = true; };
+
+static Parsed parse(const uint8_t* d, size_t n){
+  struct G { uint16_t page=0; uint32_t size=0, count=0; int32_t lmin=0, lmax=0; uint8_t rid=0; };
+  Parsed p; G g; std::vector<G> stack; std::vector<uint32_t> usages;
+  uint32_t bits[256][2] = {};
+  for(size_t i=0; i<n; ){
+    const uint8_t b = d[i];
+    const int sz = (b & 3)==3 ? 4 : (b & 3);
+    if(i+1+sz > n){ p.ok = false; break; }
+    uint32_t u = 0; for(int k=0;k<sz;k++) u |= (uint32_t)d[i+1+k] << (8*k);
+    int32_t s = sz==1 ? (int8_t)u : sz==2 ? (int16_t)u : (int32_t)u;
+    const uint8_t type = (b>>2) & 3, tag = b>>4;
+    if(type==0){          // main
+      if(tag==0x8 || tag==0xB){
+        const int k = tag==0x8 ? 0 : 1;
+        for(uint32_t c=0; c<g.count; c++){
+          uint32_t us = usages.empty() ? 0 : usages[min<size_t>(c, usages.size()-1)];
+          p.f.push_back(Field{g.rid, k ? 'F' : 'I', (uint16_t)(us>>16 ? us>>16 : g.page), (uint16_t)us,
+                              bits[g.rid][k], g.size, g.lmin, g.lmax, (bool)(u & 1)});
+          bits[g.rid][k] += g.size;
+        }
+      }else if(tag==0xA){ if(p.depth==0 && u==1) p.apps++; p.depth++; p.maxDepth = max(p.maxDepth, p.depth); }
+      else if(tag==0xC){ if(--p.depth < 0) p.ok = false; }
+      usages.clear();
+    }else if(type==1){    // global
+      switch(tag){
+        case 0x0: g.page = (uint16_t)u; break;
+        case 0x1: g.lmin = s; break;
+        case 0x2: g.lmax = s; break;
+        case 0x7: g.size = u; break;
+        case 0x8: g.rid = (uint8_t)u; break;
+        case 0x9: g.count = u; break;
+        case 0xA: stack.push_back(g); break;
+        case 0xB: if(stack.empty()) p.ok = false; else { g = stack.back(); stack.pop_back(); } break;
+      }
+    }else if(type==2){    // local
+      if(tag==0x0) usages.push_back(sz==4 ? u : ((uint32_t)g.page<<16) | u);
+    }
+    i += 1 + sz;
+  }
+  if(p.depth) p.ok = false;
+  return p;
+}
+
+static std::vector<Field> find(const Parsed& p, uint8_t rid, char kind, uint16_t page, uint16_t usage){
+  std::vector<Field> out;
+  for(const Field& f : p.f) if(f.rid==rid && f.kind==kind && f.page==page && f.usage==usage && !f.cnst) out.push_back(f);
+  return out;
+}
+static uint32_t reportBits(const Parsed& p, uint8_t rid, char kind){
+  uint32_t n = 0; for(const Field& f : p.f) if(f.rid==rid && f.kind==kind) n += f.size; return n;
+}
+
+TEST(touchDescriptorMatchesReport){
+  Parsed p = parse(touchDesc, sizeof(touchDesc));
+  CHECK(p.ok);
+  CHECK_EQ(p.apps, 1);
+  CHECK_EQ(reportBits(p, HID_REPORT_ID_TOUCH, 'I'), (uint32_t)sizeof(TouchReport)*8);
+  std::vector<Field> tip = find(p, HID_REPORT_ID_TOUCH, 'I', 0x0D, 0x42);
+  std::vector<Field> cid = find(p, HID_REPORT_ID_TOUCH, 'I', 0x0D, 0x51);
+  std::vector<Field> x   = find(p, HID_REPORT_ID_TOUCH, 'I', 0x01, 0x30);
+  std::vector<Field> y   = find(p, HID_REPORT_ID_TOUCH, 'I', 0x01, 0x31);
+  CHECK_EQ(tip.size(), (size_t)TOUCH_MAX);
+  CHECK_EQ(cid.size(), (size_t)TOUCH_MAX);
+  CHECK_EQ(x.size(), (size_t)TOUCH_MAX);
+  CHECK_EQ(y.size(), (size_t)TOUCH_MAX);
+  for(size_t i=0; i<TOUCH_MAX && i<tip.size() && i<cid.size() && i<x.size() && i<y.size(); i++){
+    const uint32_t base = (offsetof(TouchReport, c) + i*sizeof(TouchContact)) * 8;
+    CHECK_EQ(tip[i].bit, base + offsetof(TouchContact, tip)*8); CHECK_EQ(tip[i].size, 1u);
+    CHECK_EQ(cid[i].bit, base + offsetof(TouchContact, id)*8);  CHECK_EQ(cid[i].size, 8u);
+    CHECK_EQ(x[i].bit,   base + offsetof(TouchContact, x)*8);   CHECK_EQ(x[i].size, 16u);
+    CHECK_EQ(y[i].bit,   base + offsetof(TouchContact, y)*8);   CHECK_EQ(y[i].size, 16u);
+    CHECK_EQ(x[i].lmin, 0); CHECK_EQ(x[i].lmax, (int32_t)TOUCH_LOGICAL_MAX);
+    CHECK_EQ(y[i].lmin, 0); CHECK_EQ(y[i].lmax, (int32_t)TOUCH_LOGICAL_MAX);
+  }
+  std::vector<Field> cc = find(p, HID_REPORT_ID_TOUCH, 'I', 0x0D, 0x54);
+  CHECK_EQ(cc.size(), 1u);
+  if(cc.size()==1){ CHECK_EQ(cc[0].bit, (uint32_t)offsetof(TouchReport, count)*8); CHECK_EQ(cc[0].size, 8u); }
+  // Contact Count Maximum: 1 byte (o que _onGetFeature devolve), máximo = TOUCH_MAX
+  std::vector<Field> ccm = find(p, HID_REPORT_ID_TOUCH_MAX, 'F', 0x0D, 0x55);
+  CHECK_EQ(ccm.size(), 1u);
+  CHECK_EQ(reportBits(p, HID_REPORT_ID_TOUCH_MAX, 'F'), 8u);
+  if(ccm.size()==1) CHECK_EQ(ccm[0].lmax, (int32_t)TOUCH_MAX);
+}
+
+TEST(wheelDescriptorMatchesReport){
+  Parsed p = parse(wheelDesc, sizeof(wheelDesc));
+  CHECK(p.ok);
+  CHECK_EQ(reportBits(p, HID_REPORT_ID_WHEEL, 'I'), (uint32_t)sizeof(WheelReport)*8);
+  std::vector<Field> w = find(p, HID_REPORT_ID_WHEEL, 'I', 0x01, 0x38);
+  std::vector<Field> pan = find(p, HID_REPORT_ID_WHEEL, 'I', 0x0C, 0x0238);
+  CHECK_EQ(w.size(), 1u); CHECK_EQ(pan.size(), 1u);
+  if(w.size()==1){ CHECK_EQ(w[0].bit, (uint32_t)offsetof(WheelReport, wheel)*8); CHECK_EQ(w[0].size, 16u); CHECK_EQ(w[0].lmin, -32767); }
+  if(pan.size()==1){ CHECK_EQ(pan[0].bit, (uint32_t)offsetof(WheelReport, pan)*8); CHECK_EQ(pan[0].size, 16u); }
+  // um byte de feature: multiplicadores nos bits 0 e 2 (máscara 0x05 do _onSetFeature)
+  std::vector<Field> m = find(p, HID_REPORT_ID_WHEEL_MULT, 'F', 0x01, 0x48);
+  CHECK_EQ(m.size(), 2u);
+  CHECK_EQ(reportBits(p, HID_REPORT_ID_WHEEL_MULT, 'F'), 8u);
+  if(m.size()==2){ CHECK_EQ(m[0].bit, 0u); CHECK_EQ(m[1].bit, 2u); CHECK_EQ(m[0].size, 2u); }
+}
+
+// ===== Agendamento dos contatos =====
+// Reproduz o report sombra do hidExec: TOUCH atualiza um contato, TFRAME envia (count = a).
+struct Frame { TouchReport r; uint32_t atMs; };
+static std::vector<Frame> frames(const Step& st, uint32_t* touchMs = nullptr){
+  rec.clear(); cursorForget();
+  execStep(st, NO_JIT);
+  std::vector<Frame> out; TouchReport sh = {}; uint32_t t = 0, inTouch = 0; int phase = -1;
+  for(const HidOp& o : rec){
+    if(o.op==OP_PHASE) phase = o.x ? o.a : -1;
+    else if(o.op==OP_WAIT){ t += o.ms; if(phase==PH_TOUCH) inTouch += o.ms; }
+    else if(o.op==OP_TOUCH) sh.c[o.a] = TouchContact{(uint8_t)(o.ms & 1), o.a, (uint16_t)o.x, (uint16_t)o.y};
+    else if(o.op==OP_TFRAME){ sh.count = o.a; out.push_back(Frame{sh, t}); }
+  }
+  if(touchMs) *touchMs = inTouch;
+  return out;
+}
+static Step gesture(const char* type, const char* text, int durMs, int stepsN){
+  Step s; s.type=type; s.text=text; s.durMs=durMs; s.stepsN=stepsN; s.delayMs=1; return s;
+}
+
+TEST(twoFingerScrollSchedule){
+  uint32_t ms = 0;
+  std::vector<Frame> f = frames(gesture("touch", "800,600>800,300;900,600>900,300", 100, 12), &ms);
+  CHECK_EQ(ms, 100u);                                // soma das esperas = durMs (resto no último frame)
+  CHECK_EQ(f.size(), (size_t)12 + 1 + 1);            // frames 0..12 + levantar
+  if(f.size() != 14) return;
+  for(const Frame& fr : f) CHECK_EQ(fr.r.count, 2);
+  // primeiro frame: dois dedos encostam juntos no início do caminho
+  for(int k=0;k<2;k++){
+    CHECK_EQ(f[0].r.c[k].tip, 1); CHECK_EQ(f[0].r.c[k].id, k);
+    CHECK_EQ(f[0].r.c[k].y, (uint16_t)touchLogical(600, screenH));
+  }
+  CHECK_EQ(f[0].r.c[0].x, (uint16_t)touchLogical(800, screenW));
+  CHECK_EQ(f[0].r.c[1].x, (uint16_t)touchLogical(900, screenW));
+  CHECK_EQ(f[0].atMs, 0u);
+  // penúltimo: chegou ao fim ainda encostado; último: levanta no mesmo lugar, no mesmo instante
+  const Frame& end = f[12]; const Frame& lift = f[13];
+  for(int k=0;k<2;k++){
+    CHECK_EQ(end.r.c[k].tip, 1); CHECK_EQ(end.r.c[k].y, (uint16_t)touchLogical(300, screenH));
+    CHECK_EQ(lift.r.c[k].tip, 0); CHECK_EQ(lift.r.c[k].x, end.r.c[k].x); CHECK_EQ(lift.r.c[k].y, end.r.c[k].y);
+  }
+  CHECK_EQ(lift.atMs, 100u); CHECK_EQ(end.atMs, 100u);
+  // sem frames repetidos; y desce monotonicamente
+  for(size_t i=1;i<f.size();i++){
+    CHECK(memcmp(&f[i].r, &f[i-1].r, sizeof(TouchReport)) != 0);
+    if(i<13) CHECK(f[i].r.c[0].y < f[i-1].r.c[0].y);
+  }
+}
+
+TEST(stationaryTapHold){
+  uint32_t ms = 0;
+  std::vector<Frame> f = frames(gesture("touch", "400,300;1200,300", 250, 0), &ms);
+  CHECK_EQ(ms, 250u);
+  CHECK_EQ(f.size(), 2u);                            // encosta, segura durMs, levanta (sem frames parados)
+  if(f.size()==2){
+    CHECK_EQ(f[0].r.c[0].tip + f[0].r.c[1].tip, 2);
+    CHECK_EQ(f[1].r.c[0].tip + f[1].r.c[1].tip, 0);
+    CHECK_EQ(f[1].atMs - f[0].atMs, 250u);
+  }
+}
+
+TEST(pinchIsSymmetric){
+  Step st; st.type="pinch"; st.x=960; st.y=540; st.x2=100; st.y2=500; st.durMs=80; st.stepsN=10; st.delayMs=1;
+  uint32_t ms = 0;
+  std::vector<Frame> f = frames(st, &ms);
+  CHECK_EQ(ms, 80u);
+  CHECK_EQ(f.size(), 12u);
+  const int center = touchLogical(960, screenW);
+  int lastGap = -1;
+  for(size_t i=0;i+1<f.size();i++){
+    const TouchContact& a = f[i].r.c[0]; const TouchContact& b = f[i].r.c[1];
+    CHECK_EQ(a.y, b.y);
+    CHECK(abs(((int)a.x + (int)b.x) - 2*center) <= 2);  // simétrico em torno do centro (arredondamento)
+    const int gap = (int)b.x - (int)a.x;
+    CHECK(gap > lastGap);                              // x2 < y2: dedos se afastam (zoom in)
+    lastGap = gap;
+  }
+  CHECK_EQ(f[0].r.c[1].x - f[0].r.c[0].x, touchLogical(1010, screenW) - touchLogical(910, screenW));
+  CHECK_EQ(f.back().r.c[0].tip + f.back().r.c[1].tip, 0);
+}
+
+TEST(parseAndScale){
+  TouchPath c[TOUCH_MAX];
+  CHECK_EQ(touchParse("1,2;3,4;5,6;7,8;9,10", c), 5);
+  CHECK_EQ(touchParse("1,2;3,4;5,6;7,8;9,10;11,12", c), -1);           // > TOUCH_MAX contatos
+  CHECK_EQ(touchParse("1,2>3,4>5,6>7,8>9,10>11,12>13,14>15,16>17,18", c), -1);  // > 8 waypoints
+  CHECK_EQ(touchParse("1;2", c), -1);
+  CHECK_EQ(touchParse("10,20>30,40", c), 1);
+  CHECK_EQ(c[0].n, 2); CHECK_EQ(c[0].x[1], 30); CHECK_EQ(c[0].y[1], 40);
+  CHECK_EQ(touchLogical(0, 1920), 0);
+  CHECK_EQ(touchLogical(1919, 1920), (int16_t)TOUCH_LOGICAL_MAX);
+  CHECK_EQ(touchLogical(-50, 1920), 0);
+  CHECK_EQ(touchLogical(5000, 1920), (int16_t)TOUCH_LOGICAL_MAX);
+  // texto inválido: nenhum frame
+  CHECK_EQ(frames(gesture("touch", "x", 100, 1)).size(), 0u);
+}
+
+int main(){
+  RUN(touchDescriptorMatchesReport);
+  RUN(wheelDescriptorMatchesReport);
+  RUN(twoFingerScrollSchedule);
+  RUN(stationaryTapHold);
+  RUN(pinchIsSymmetric);
+  RUN(parseAndScale);
+  TEST_DONE();
+}
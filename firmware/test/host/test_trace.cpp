@@ -0,0 +1,171 @@
+// Timeline do dry-run na simulação de host: execStep emite as ops, o "hidExec" de teste faz o que o
+// firmware faz em dry-run (WAIT avança o relógio virtual, PHASE/STEP vão para o TraceLog). Macro com
+// bem mais de 512 eventos: o ring dá a volta, os acumuladores continuam fechando com o stream inteiro.
+#include "check.h"
+#include "macro.h"
+#include "trace.h"
+#include <string>
+#include <vector>
+
+int   screenW = 1920, screenH = 1080;
+float countsPerPixel = 1.0f;
+int   actionDelay = 1500;
+JitterCfg jitter;
+
+static const int NSTEPS = 160;   // MAX_STEPS do firmware
+static TraceLog<512, NSTEPS> trace;
+static uint64_t clockUs = 0;
+static uint16_t curStep = 0;
+static std::vector<HidOp> rec;
+
+void hidEmit(const HidOp& o){
+  rec.push_back(o);
+  switch(o.op){
+    case OP_WAIT:  clockUs += (uint64_t)o.ms*1000; break;
+    case OP_PHASE: trace.phase(o, curStep, clockUs); break;
+    case OP_STEP:  curStep = (uint16_t)o.x; break;
+    default: break;
+  }
+}
+
+static std::vector<Step> macro(){
+  std::vector<Step> v;
+  for(int i=0;i<NSTEPS;i++){
+    Step s;
+    switch(i%4){
+      case 0: s.type="tap";  s.x=100+i; s.y=200; s.delayMs=40+i; break;
+      case 1: s.type="type"; s.text="ab"; s.delayMs=7; break;
+      case 2: s.type="wait"; s.delayMs=300; break;
+      default: s.type="drag"; s.x=10; s.y=10; s.x2=60; s.y2=10; s.durMs=50; s.stepsN=5; break;  // delay global
+    }
+    v.push_back(s);
+  }
+  return v;
+}
+
+// Mesma sequência do runOnce() do firmware.
+static void runOnce(const std::vector<Step>& v){
+  trace.runBegin();
+  cursorForget();
+  curStep = 0;
+  phaseBegin(PH_START);
+  hidMove(1,0); hidWait(5); hidMove(-1,0); hidWait(5);
+  phaseEnd();
+  for(size_t i=0;i<v.size();i++){ hidStep((int)i+1); execStep(v[i], NO_JIT); }
+}
+
+// Totais esperados direto do stream de ops (sem passar pelo TraceLog).
+struct Want { uint64_t phaseUs[PH_COUNT]={}; uint32_t phaseN[PH_COUNT]={}; std::vector<uint64_t> busy, idle; uint64_t total=0; uint32_t events=0; };
+static Want expected(const std::vector<HidOp>& ops){
+  Want w; w.busy.assign(NSTEPS+1, 0); w.idle.assign(NSTEPS+1, 0);
+  int phase=-1, step=0;
+  for(const HidOp& o : ops){
+    if(o.op==OP_STEP) step=o.x;
+    else if(o.op==OP_PHASE){ if(o.x){ phase=o.a; w.phaseN[o.a]++; } else { phase=-1; w.events++; } }
+    else if(o.op==OP_WAIT){
+      const uint64_t us=(uint64_t)o.ms*1000; w.total += us;
+      if(phase<0) continue;
+      w.phaseUs[phase] += us;
+      (phase==PH_DELAY ? w.idle : w.busy)[step] += us;
+    }
+  }
+  return w;
+}
+
+TEST(accumulatorsSurviveRingWrap){
+  const std::vector<Step> v = macro();
+  rec.clear(); clockUs = 0; trace.clear();
+  runOnce(v);
+  const Want w = expected(rec);
+  CHECK(w.events > 512);
+  CHECK_EQ(trace.wr, w.events);
+  CHECK_EQ(trace.first(), w.events - 512);
+  for(int p=0;p<PH_COUNT;p++){ CHECK_EQ(trace.phaseUs[p], w.phaseUs[p]); CHECK_EQ(trace.phaseN[p], w.phaseN[p]); }
+  uint64_t busy=0, idle=0;
+  for(int i=0;i<=NSTEPS;i++){ CHECK_EQ(trace.busyUs[i], w.busy[i]); CHECK_EQ(trace.idleUs[i], w.idle[i]); busy+=trace.busyUs[i]; idle+=trace.idleUs[i]; }
+  // todo o tempo do loop está em alguma fase; delay pós-ação = delayMs do passo (ou o global)
+  CHECK_EQ(trace.t1Us - trace.t0Us, w.total);
+  CHECK_EQ(busy + idle, w.total);
+  CHECK_EQ(idle, trace.phaseUs[PH_DELAY]);
+  for(int i=0;i<NSTEPS;i++){
+    const uint64_t want = (v[i].delayMs>0 ? v[i].delayMs : actionDelay) * 1000ULL;
+    CHECK_EQ(trace.idleUs[i+1], want);
+  }
+  CHECK_EQ(trace.busyUs[1], (30 + 8 + 2 + 25) * 1000ULL);  // homing + 8 ms + (100,200) px em 2 reports + clique
+}
+
+TEST(ringKeepsNewestInOrder){
+  TraceEv e{}, prev{};
+  CHECK(!trace.get(trace.first()-1, e));
+  CHECK(!trace.get(trace.wr, e));
+  for(uint32_t i=trace.first(); i<trace.wr; i++){
+    CHECK(trace.get(i, e));
+    if(i>trace.first()) CHECK(e.t0Us >= prev.t0Us + prev.durUs);
+    CHECK(e.phase < PH_COUNT); CHECK(e.step <= NSTEPS); CHECK_EQ(e.run, trace.run);
+    prev = e;
+  }
+  CHECK_EQ(prev.step, NSTEPS); CHECK_EQ(prev.phase, PH_DELAY);
+  CHECK_EQ(prev.t0Us + prev.durUs, trace.t1Us);
+}
+
+// Export como o handleTrace monta: cabeçalho, eventos do ring, rodapé.
+TEST(chromeJsonShape){
+  std::string js = TRACE_JSON_HEAD;
+  char buf[160];
+  uint64_t durSum = 0;
+  for(uint32_t i=trace.first(); i<trace.wr; i++){
+    TraceEv e{}; trace.get(i, e);
+    const int n = traceJsonEv(buf, sizeof(buf), e);
+    CHECK(n > 0 && n < (int)sizeof(buf));  // nunca trunca
+    js += buf; durSum += e.durUs;
+  }
+  js += TRACE_JSON_TAIL;
+
+  CHECK(js.rfind("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[{", 0) == 0);
+  CHECK(js.size() > 2 && js.compare(js.size()-2, 2, "]}") == 0);
+  int depth = 0, minDepth = 1, xs = 0; bool inStr = false;
+  for(size_t i=0;i<js.size();i++){
+    const char c = js[i];
+    if(c=='"'){ inStr = !inStr; continue; }
+    if(inStr) continue;
+    if(c=='{' || c=='[') depth++;
+    if(c=='}' || c==']'){ depth--; if(i+1<js.size()) minDepth = min(minDepth, depth); }
+    if(c==',') CHECK(js[i+1]=='{' || js[i+1]=='"');  // sem vírgula sobrando
+  }
+  CHECK_EQ(depth, 0); CHECK(minDepth >= 1); CHECK(!inStr);
+  uint64_t parsedDur = 0;
+  for(size_t at = js.find("\"ph\":\"X\""); at != std::string::npos; at = js.find("\"ph\":\"X\"", at+1)){
+    xs++;
+    unsigned long long ts; unsigned long dur;
+    CHECK(sscanf(js.c_str()+at, "\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%llu,\"dur\":%lu", &ts, &dur) == 2);
+    parsedDur += dur;
+  }
+  CHECK_EQ(xs, 512);
+  CHECK_EQ(parsedDur, durSum);
+  for(const char* n : { "home", "move", "button", "text", "delay" })
+    CHECK(js.find(std::string("\"name\":\"") + n + "\",\"cat\":\"step\"") != std::string::npos);
+}
+
+TEST(nextRunResetsAccumulatorsNotRing){
+  const uint32_t wr = trace.wr; const uint8_t run = trace.run;
+  std::vector<Step> one(1); one[0].type="wait"; one[0].delayMs=10;
+  rec.clear(); clockUs = 1000000;
+  runOnce(one);
+  CHECK_EQ(trace.run, (uint8_t)(run+1));
+  CHECK_EQ(trace.wr, wr + 2);                    // start + delay
+  CHECK_EQ(trace.idleUs[1], 10000ULL);
+  CHECK_EQ(trace.idleUs[2], 0ULL);               // nada do loop anterior
+  CHECK_EQ(trace.t1Us - trace.t0Us, 20000ULL);
+  trace.on = false;                              // estimativa do otimizador: não grava
+  trace.add(PH_MOVE, 1, 0, 5);
+  CHECK_EQ(trace.wr, wr + 2);
+  trace.on = true;
+}
+
+int main(){
+  RUN(accumulatorsSurviveRingWrap);
+  RUN(ringKeepsNewestInOrder);
+  RUN(chromeJsonShape);
+  RUN(nextRunResetsAccumulatorsNotRing);
+  TEST_DONE();
+}
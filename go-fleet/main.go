@@ -0,0 +1,485 @@
+package main
+
+import (
+	"bytes"
+	"encoding/binary"
+	"encoding/json"
+	"errors"
+	"flag"
+	"fmt"
+	"io"
+	"log"
+	"net"
+	"net/http"
+	"os"
+	"sort"
+	"strconv"
+	"strings"
+	"sync"
+	"time"
+)
+
+// Serviço anunciado pelo firmware (MDNS.addService("autoclicker","tcp",80)).
+const service = "_autoclicker._tcp.local"
+
+type Device struct {
+	Name string
+	Addr string // host:port
+}
+
+var client = &http.Client{
+	Timeout: 5 * time.Second,
+	// /stop e /runOnce respondem 302 para a UI; aqui basta o status
+	CheckRedirect: func(*http.Request, []*http.Request) error { return http.ErrUseLastResponse },
+}
+
+// ================= mDNS (consulta PTR one-shot) =================
+
+func mdnsQuery(name string) []byte {
+	var b bytes.Buffer
+	b.Write([]byte{0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0}) // id=0, flags=0, 1 pergunta
+	for _, l := range strings.Split(name, ".") {
+		b.WriteByte(byte(len(l)))
+		b.WriteString(l)
+	}
+	b.WriteByte(0)
+	b.Write([]byte{0, 12, 0x80, 1}) // PTR, IN com bit QU (resposta unicast)
+	return b.Bytes()
+}
+
+var errShort = errors.New("mdns: short packet")
+
+func readName(msg []byte, off int) (string, int, error) {
+	var labels []string
+	end := -1
+	for hops := 0; hops < 128; hops++ {
+		if off >= len(msg) {
+			return "", 0, errShort
+		}
+		l := int(msg[off])
+		switch {
+		case l == 0:
+			if end < 0 {
+				end = off + 1
+			}
+			return strings.Join(labels, "."), end, nil
+		case l&0xC0 == 0xC0:
+			if off+1 >= len(msg) {
+				return "", 0, errShort
+			}
+			if end < 0 {
+				end = off + 2
+			}
+			off = int(binary.BigEndian.Uint16(msg[off:]) & 0x3FFF)
+		default:
+			if off+1+l > len(msg) {
+				return "", 0, errShort
+			}
+			labels = append(labels, string(msg[off+1:off+1+l]))
+			off += 1 + l
+		}
+	}
+	return "", 0, errors.New("mdns: name loop")
+}
+
+type srvRec struct {
+	target string
+	port   uint16
+}
+
+func parseMDNS(msg []byte, src net.IP) []Device {
+	if len(msg) < 12 {
+		return nil
+	}
+	qd := int(binary.BigEndian.Uint16(msg[4:]))
+	rrs := int(binary.BigEndian.Uint16(msg[6:])) + int(binary.BigEndian.Uint16(msg[8:])) + int(binary.BigEndian.Uint16(msg[10:]))
+	off := 12
+	for i := 0; i < qd; i++ {
+		_, o, err := readName(msg, off)
+		if err != nil {
+			return nil
+		}
+		off = o + 4
+	}
+	var ptrs []string
+	srv := map[string]srvRec{}
+	ids := map[string]string{} // instância -> TXT id
+	addrs := map[string]net.IP{}
+	for i := 0; i < rrs; i++ {
+		name, o, err := readName(msg, off)
+		if err != nil || o+10 > len(msg) {
+			break
+		}
+		typ := binary.BigEndian.Uint16(msg[o:])
+		rdlen := int(binary.BigEndian.Uint16(msg[o+8:]))
+		rd := o + 10
+		if rd+rdlen > len(msg) {
+			break
+		}
+		switch typ {
+		case 12: // PTR
+			if t, _, err := readName(msg, rd); err == nil && strings.EqualFold(name, service) {
+				ptrs = append(ptrs, t)
+			}
+		case 33: // SRV
+			if rdlen >= 7 {
+				if t, _, err := readName(msg, rd+6); err == nil {
+					srv[strings.ToLower(name)] = srvRec{target: t, port: binary.BigEndian.Uint16(msg[rd+4:])}
+				}
+			}
+		case 16: // TXT: strings <len><chave=valor>
+			for p := rd; p < rd+rdlen; {
+				l := int(msg[p])
+				if p+1+l > rd+rdlen {
+					break
+				}
+				if k, v, ok := strings.Cut(string(msg[p+1:p+1+l]), "="); ok && k == "id" {
+					ids[strings.ToLower(name)] = v
+				}
+				p += 1 + l
+			}
+		case 1: // A
+			if rdlen == 4 {
+				addrs[strings.ToLower(name)] = net.IPv4(msg[rd], msg[rd+1], msg[rd+2], msg[rd+3])
+			}
+		}
+		off = rd + rdlen
+	}
+	var out []Device
+	// Todas as placas usam o host autoclicker.local: o nome vem do TXT id (ou da instância)
+	// e o endereço do A que veio no mesmo pacote, senão da origem do pacote.
+	for _, inst := range ptrs {
+		name, ip, port := strings.TrimSuffix(inst, "."+service), src, 80
+		if id := ids[strings.ToLower(inst)]; id != "" {
+			name = id
+		}
+		if s, ok := srv[strings.ToLower(inst)]; ok {
+			port = int(s.port)
+			if a, ok := addrs[strings.ToLower(s.target)]; ok {
+				ip = a
+			}
+		}
+		out = append(out, Device{Name: name, Addr: net.JoinHostPort(ip.String(), strconv.Itoa(port))})
+	}
+	return out
+}
+
+func discover(timeout time.Duration) ([]Device, error) {
+	conn, err := net.ListenUDP("udp4", &net.UDPAddr{IP: net.IPv4zero})
+	if err != nil {
+		return nil, err
+	}
+	defer conn.Close()
+	dst := &net.UDPAddr{IP: net.IPv4(224, 0, 0, 251), Port: 5353}
+	if _, err := conn.WriteToUDP(mdnsQuery(service), dst); err != nil {
+		return nil, err
+	}
+	_ = conn.SetReadDeadline(time.Now().Add(timeout))
+	found := map[string]Device{}
+	buf := make([]byte, 9000)
+	for {
+		n, src, err := conn.ReadFromUDP(buf)
+		if err != nil {
+			var ne net.Error
+			if errors.As(err, &ne) && ne.Timeout() {
+				break
+			}
+			return nil, err
+		}
+		for _, d := range parseMDNS(buf[:n], src.IP) {
+			found[d.Addr] = d
+		}
+	}
+	devs := make([]Device, 0, len(found))
+	for _, d := range found {
+		devs = append(devs, d)
+	}
+	sort.Slice(devs, func(i, j int) bool { return devs[i].Name < devs[j].Name })
+	return devs, nil
+}
+
+// ================= HTTP helpers =================
+
+// Resposta >= 400 do device; o código decide fallbacks (ex.: 409 no delta).
+type httpError struct {
+	Code int
+	Msg  string
+}
+
+func (e *httpError) Error() string { return fmt.Sprintf("%d %s", e.Code, e.Msg) }
+
+func call(method string, d Device, path string, body []byte, out any) error {
+	req, err := http.NewRequest(method, "http://"+d.Addr+path, bytes.NewReader(body))
+	if err != nil {
+		return err
+	}
+	if body != nil {
+		req.Header.Set("Content-Type", "application/json")
+	}
+	resp, err := client.Do(req)
+	if err != nil {
+		return err
+	}
+	defer resp.Body.Close()
+	data, _ := io.ReadAll(resp.Body)
+	if resp.StatusCode >= 400 {
+		return fmt.Errorf("%s %s: %w", method, path, &httpError{resp.StatusCode, strings.TrimSpace(string(data))})
+	}
+	if out != nil {
+		return json.Unmarshal(data, out)
+	}
+	return nil
+}
+
+// Roda fn em todos os devices em paralelo e imprime uma linha por device, na ordem.
+func forEach(devs []Device, fn func(Device) (string, error)) int {
+	res := make([]string, len(devs))
+	fails := 0
+	var mu sync.Mutex
+	var wg sync.WaitGroup
+	for i, d := range devs {
+		wg.Add(1)
+		go func(i int, d Device) {
+			defer wg.Done()
+			s, err := fn(d)
+			if err != nil {
+				s = "ERRO: " + err.Error()
+				mu.Lock()
+				fails++
+				mu.Unlock()
+			}
+			res[i] = fmt.Sprintf("%-22s %-21s %s", d.Name, d.Addr, s)
+		}(i, d)
+	}
+	wg.Wait()
+	for _, l := range res {
+		fmt.Println(l)
+	}
+	return fails
+}
+
+// ================= Sincronização de relógio =================
+
+var base = time.Now()
+
+func hostUs() int64 { return time.Since(base).Microseconds() } // monotônico
+
+type clockSample struct {
+	offsetUs int64 // relógio do device - relógio do host
+	rttUs    int64
+}
+
+// Estilo NTP: fica com a amostra de menor RTT; o erro fica limitado a rtt/2.
+func syncClock(d Device, samples int) (clockSample, error) {
+	best := clockSample{rttUs: -1}
+	for i := 0; i < samples; i++ {
+		var r struct {
+			Us int64 `json:"us"`
+		}
+		t0 := hostUs()
+		if err := call(http.MethodGet, d, "/clock", nil, &r); err != nil {
+			return best, err
+		}
+		t1 := hostUs()
+		if best.rttUs < 0 || t1-t0 < best.rttUs {
+			best = clockSample{offsetUs: r.Us - (t0+t1)/2, rttUs: t1 - t0}
+		}
+	}
+	return best, nil
+}
+
+// ================= Comandos =================
+
+func cmdStatus(devs []Device) int {
+	var mu sync.Mutex
+	running, underruns := 0, 0
+	fails := forEach(devs, func(d Device) (string, error) {
+		var s struct {
+			ID        string `json:"id"`
+			Running   bool   `json:"running"`
+			Armed     bool   `json:"armed"`
+			Step      int    `json:"step"`
+			Count     int    `json:"count"`
+			LoopsLeft int    `json:"loops_left"`
+			HidQMax   int    `json:"hid_q_max"`
+			Underruns int    `json:"hid_underruns"`
+		}
+		if err := call(http.MethodGet, d, "/status", nil, &s); err != nil {
+			return "", err
+		}
+		mu.Lock()
+		if s.Running {
+			running++
+		}
+		underruns += s.Underruns
+		mu.Unlock()
+		st := "standby"
+		if s.Armed {
+			st = "armed"
+		} else if s.Running {
+			st = "running"
+		}
+		loops := strconv.Itoa(s.LoopsLeft)
+		if s.LoopsLeft < 0 {
+			loops = "inf"
+		}
+		return fmt.Sprintf("%-8s step %d/%d loops %s hid_q_max %d underruns %d", st, s.Step, s.Count, loops, s.HidQMax, s.Underruns), nil
+	})
+	fmt.Printf("-- %d devices, %d rodando, %d sem resposta, %d underruns HID no total\n", len(devs), running, fails, underruns)
+	return fails
+}
+
+func cmdPush(devs []Device, file string) int {
+	data, err := os.ReadFile(file)
+	if err != nil {
+		log.Fatal(err)
+	}
+	var m struct {
+		Steps []json.RawMessage `json:"steps"`
+	}
+	if err := json.Unmarshal(data, &m); err != nil || m.Steps == nil {
+		log.Fatalf("%s: esperado JSON com \"steps\" (formato do /export)", file)
+	}
+	return forEach(devs, func(d Device) (string, error) {
+		if err := call(http.MethodPost, d, "/steps/set", data, nil); err != nil {
+			return "", err
+		}
+		return fmt.Sprintf("ok (%d passos)", len(m.Steps)), nil
+	})
+}
+
+func cmdStart(devs []Device, loops int, lead time.Duration, samples int) int {
+	clocks := make([]clockSample, len(devs))
+	errs := make([]error, len(devs))
+	var wg sync.WaitGroup
+	for i, d := range devs {
+		wg.Add(1)
+		go func(i int, d Device) {
+			defer wg.Done()
+			clocks[i], errs[i] = syncClock(d, samples)
+		}(i, d)
+	}
+	wg.Wait()
+
+	// mesmo instante do host para todos, convertido para o relógio de cada device
+	at := hostUs() + lead.Microseconds()
+	idx := map[string]int{}
+	for i, d := range devs {
+		idx[d.Addr] = i
+	}
+	fails := forEach(devs, func(d Device) (string, error) {
+		i := idx[d.Addr]
+		if errs[i] != nil {
+			return "", errs[i]
+		}
+		c := clocks[i]
+		path := fmt.Sprintf("/runLoop?n=%d&at=%d", loops, at+c.offsetUs)
+		if err := call(http.MethodPost, d, path, nil, nil); err != nil {
+			// 409: at já passou ou a placa está rodando/em dry-run (só veria at no fim do loop)
+			return "", fmt.Errorf("não armado: %w", err)
+		}
+		return fmt.Sprintf("armado (±%.1f ms)", float64(c.rttUs)/2000), nil
+	})
+	if wait := time.Duration(at-hostUs()) * time.Microsecond; wait > 0 {
+		fmt.Printf("-- início em %v\n", wait.Round(time.Millisecond))
+	}
+	return fails
+}
+
+func cmdSimple(devs []Device, method, path string) int {
+	return forEach(devs, func(d Device) (string, error) {
+		if err := call(method, d, path, nil, nil); err != nil {
+			return "", err
+		}
+		return "ok", nil
+	})
+}
+
+func usage() {
+	fmt.Fprintf(os.Stderr, `uso: fleet [-hosts ip1,ip2] [-discover 2s] <comando>
+
+  discover                  lista os devices (_autoclicker._tcp via mDNS)
+  status                    status e métricas HID agregados
+  push [-delta] <macro.json>
+                            envia a macro (formato do /export) para todos, em paralelo;
+                            -delta manda só os passos alterados (manifest + CRC32)
+  ota <firmware.bin>        grava o firmware (MD5 conferido); aplica entre loops
+  start [-n 0] [-lead 500ms] [-samples 8]
+                            início sincronizado (n=0: infinito)
+  stop                      para todos
+`)
+	os.Exit(2)
+}
+
+func main() {
+	hosts := flag.String("hosts", "", "lista de host[:porta] separada por vírgula (pula o mDNS)")
+	disc := flag.Duration("discover", 2*time.Second, "tempo de espera das respostas mDNS")
+	flag.Usage = usage
+	flag.Parse()
+	if flag.NArg() < 1 {
+		usage()
+	}
+
+	var devs []Device
+	if *hosts != "" {
+		for _, h := range strings.Split(*hosts, ",") {
+			h = strings.TrimSpace(h)
+			if h == "" {
+				continue
+			}
+			if _, _, err := net.SplitHostPort(h); err != nil {
+				h = net.JoinHostPort(h, "80")
+			}
+			devs = append(devs, Device{Name: h, Addr: h})
+		}
+	} else {
+		var err error
+		if devs, err = discover(*disc); err != nil {
+			log.Fatal("mdns: ", err)
+		}
+	}
+	if len(devs) == 0 {
+		log.Fatal("nenhum device encontrado")
+	}
+
+	fails := 0
+	switch cmd, args := flag.Arg(0), flag.Args()[1:]; cmd {
+	case "discover":
+		for _, d := range devs {
+			fmt.Printf("%-22s %s\n", d.Name, d.Addr)
+		}
+	case "status":
+		fails = cmdStatus(devs)
+	case "push":
+		fs := flag.NewFlagSet("push", flag.ExitOnError)
+		delta := fs.Bool("delta", false, "envia só os passos alterados")
+		_ = fs.Parse(args)
+		if fs.NArg() != 1 {
+			usage()
+		}
+		if *delta {
+			fails = cmdPushDelta(devs, fs.Arg(0))
+		} else {
+			fails = cmdPush(devs, fs.Arg(0))
+		}
+	case "ota":
+		if len(args) != 1 {
+			usage()
+		}
+		fails = cmdOTA(devs, args[0])
+	case "start":
+		fs := flag.NewFlagSet("start", flag.ExitOnError)
+		n := fs.Int("n", 0, "loops (0 = infinito)")
+		lead := fs.Duration("lead", 500*time.Millisecond, "antecedência do início")
+		samples := fs.Int("samples", 8, "amostras de relógio por device")
+		_ = fs.Parse(args)
+		fails = cmdStart(devs, *n, *lead, *samples)
+	case "stop":
+		fails = cmdSimple(devs, http.MethodPost, "/stop")
+	default:
+		usage()
+	}
+	if fails > 0 {
+		os.Exit(1)
+	}
+}
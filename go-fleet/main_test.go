@@ -0,0 +1,302 @@
+package main
+
+import (
+	"encoding/binary"
+	"encoding/json"
+	"fmt"
+	"net"
+	"net/http"
+	"net/http/httptest"
+	"strconv"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"testing"
+	"time"
+)
+
+// ================= pacotes mDNS de teste =================
+
+// dnsMsg monta respostas mDNS com compressão: names lembra o offset de cada sufixo já escrito.
+type dnsMsg struct {
+	b     []byte
+	names map[string]int
+}
+
+func newMsg(qd, an, ar int) *dnsMsg {
+	m := &dnsMsg{b: make([]byte, 12), names: map[string]int{}}
+	binary.BigEndian.PutUint16(m.b[2:], 0x8400) // resposta autoritativa
+	binary.BigEndian.PutUint16(m.b[4:], uint16(qd))
+	binary.BigEndian.PutUint16(m.b[6:], uint16(an))
+	binary.BigEndian.PutUint16(m.b[10:], uint16(ar))
+	return m
+}
+
+func (m *dnsMsg) name(n string) []byte { return m.nameAt(n, len(m.b)) }
+
+// nameAt codifica n para ser escrito no offset at (registra os sufixos novos lá).
+func (m *dnsMsg) nameAt(n string, at int) []byte {
+	var out []byte
+	labels := strings.Split(n, ".")
+	for i := range labels {
+		suffix := strings.ToLower(strings.Join(labels[i:], "."))
+		if off, ok := m.names[suffix]; ok {
+			return append(out, 0xC0|byte(off>>8), byte(off))
+		}
+		m.names[suffix] = at + len(out)
+		out = append(out, byte(len(labels[i])))
+		out = append(out, labels[i]...)
+	}
+	return append(out, 0)
+}
+
+func (m *dnsMsg) question(n string) *dnsMsg {
+	m.b = append(m.b, m.name(n)...)
+	m.b = append(m.b, 0, 12, 0x80, 1)
+	return m
+}
+
+func (m *dnsMsg) rr(n string, typ uint16, rdata func() []byte) *dnsMsg {
+	m.b = append(m.b, m.name(n)...)
+	hdr := make([]byte, 10)
+	binary.BigEndian.PutUint16(hdr, typ)
+	binary.BigEndian.PutUint16(hdr[2:], 0x8001)
+	binary.BigEndian.PutUint32(hdr[4:], 120)
+	m.b = append(m.b, hdr...)
+	lenAt := len(m.b) - 2
+	rd := rdata() // escreve depois do cabeçalho: nomes comprimidos apontam para offsets corretos
+	binary.BigEndian.PutUint16(m.b[lenAt:], uint16(len(rd)))
+	m.b = append(m.b, rd...)
+	return m
+}
+
+func (m *dnsMsg) ptr(n, target string) *dnsMsg {
+	return m.rr(n, 12, func() []byte { return m.name(target) })
+}
+
+func (m *dnsMsg) srv(n string, port uint16, target string) *dnsMsg {
+	return m.rr(n, 33, func() []byte {
+		rd := []byte{0, 0, 0, 0, byte(port >> 8), byte(port)} // prioridade, peso, porta
+		return append(rd, m.nameAt(target, len(m.b)+len(rd))...)
+	})
+}
+
+func (m *dnsMsg) txt(n string, kv ...string) *dnsMsg {
+	return m.rr(n, 16, func() []byte {
+		var rd []byte
+		for _, s := range kv {
+			rd = append(rd, byte(len(s)))
+			rd = append(rd, s...)
+		}
+		return rd
+	})
+}
+
+func (m *dnsMsg) a(n string, ip string) *dnsMsg {
+	return m.rr(n, 1, func() []byte { return net.ParseIP(ip).To4() })
+}
+
+func TestReadName(t *testing.T) {
+	// "a.b" em 12, "c" + ponteiro para 12 em 17
+	msg := make([]byte, 12)
+	msg = append(msg, 1, 'a', 1, 'b', 0, 1, 'c', 0xC0, 12)
+	if n, end, err := readName(msg, 12); err != nil || n != "a.b" || end != 17 {
+		t.Fatalf("simples: %q %d %v", n, end, err)
+	}
+	if n, end, err := readName(msg, 17); err != nil || n != "c.a.b" || end != 21 {
+		t.Fatalf("comprimido: %q %d %v", n, end, err)
+	}
+	// ponteiro para si mesmo: laço
+	loop := append(make([]byte, 12), 0xC0, 12)
+	if _, _, err := readName(loop, 12); err == nil {
+		t.Fatal("laço de ponteiros aceito")
+	}
+	for _, bad := range [][]byte{
+		append(make([]byte, 12), 5, 'a'),   // label passa do fim
+		append(make([]byte, 12), 0xC0),     // ponteiro cortado
+		append(make([]byte, 12), 0xC0, 99), // ponteiro para fora
+		append(make([]byte, 12), 1, 'a'),   // sem terminador
+	} {
+		if _, _, err := readName(bad, 12); err == nil {
+			t.Fatalf("aceitou %v", bad[12:])
+		}
+	}
+}
+
+func TestParseMDNS(t *testing.T) {
+	src := net.IPv4(10, 0, 0, 9)
+	inst := "autoclicker-1a2b." + service
+	full := newMsg(1, 1, 3).
+		question(service).
+		ptr(service, inst).
+		srv(inst, 8080, "autoclicker.local").
+		txt(inst, "v=2", "id=autoclicker-1a2b").
+		a("autoclicker.local", "192.168.0.44")
+	got := parseMDNS(full.b, src)
+	want := []Device{{Name: "autoclicker-1a2b", Addr: "192.168.0.44:8080"}}
+	if fmt.Sprint(got) != fmt.Sprint(want) {
+		t.Fatalf("completo: %v, quer %v", got, want)
+	}
+
+	// duas placas, mesmo host autoclicker.local, pacotes separados: nomes e IPs distintos
+	other := newMsg(0, 1, 2).
+		ptr(service, "autoclicker-ffee."+service).
+		srv("autoclicker-ffee."+service, 80, "autoclicker.local").
+		a("autoclicker.local", "192.168.0.45")
+	if got := parseMDNS(other.b, src); fmt.Sprint(got) != fmt.Sprint([]Device{{"autoclicker-ffee", "192.168.0.45:80"}}) {
+		t.Fatalf("segunda placa: %v", got)
+	}
+
+	// só PTR: instância como nome, origem do pacote, porta 80
+	bare := newMsg(0, 1, 0).ptr(service, inst)
+	if got := parseMDNS(bare.b, src); fmt.Sprint(got) != fmt.Sprint([]Device{{"autoclicker-1a2b", "10.0.0.9:80"}}) {
+		t.Fatalf("só PTR: %v", got)
+	}
+
+	// outro serviço é ignorado
+	alien := newMsg(0, 1, 0).ptr("_http._tcp.local", "x._http._tcp.local")
+	if got := parseMDNS(alien.b, src); len(got) != 0 {
+		t.Fatalf("serviço alheio: %v", got)
+	}
+
+	// truncado em qualquer ponto: nunca entra em pânico nem inventa device
+	for n := 0; n < len(full.b); n++ {
+		for _, d := range parseMDNS(full.b[:n], src) {
+			if d.Name != "autoclicker-1a2b" {
+				t.Fatalf("truncado em %d: %v", n, d)
+			}
+		}
+	}
+}
+
+// ================= devices falsos (httptest) =================
+
+// fakeDev responde como o firmware: /clock com o relógio do host + offset, /runLoop?n=&at=
+// (409 se at já passou ou se já está rodando, como runAdmit em firmware/src/runctl.h) e /status.
+// A lógica de admissão/espera do lado da placa é testada em firmware/test/host/test_runctl.cpp.
+type fakeDev struct {
+	offsetUs  int64
+	slowFirst int32 // primeiras amostras de /clock com latência extra
+	running   bool
+	mu        sync.Mutex
+	runs      []runReq
+	srv       *httptest.Server
+}
+
+type runReq struct {
+	n  string
+	at int64
+}
+
+func newFakeDev(t *testing.T, offsetUs int64) (*fakeDev, Device) {
+	f := &fakeDev{offsetUs: offsetUs}
+	mux := http.NewServeMux()
+	mux.HandleFunc("/clock", func(w http.ResponseWriter, r *http.Request) {
+		if atomic.AddInt32(&f.slowFirst, -1) >= 0 {
+			time.Sleep(30 * time.Millisecond)
+		}
+		json.NewEncoder(w).Encode(map[string]int64{"us": hostUs() + f.offsetUs})
+	})
+	mux.HandleFunc("/runLoop", func(w http.ResponseWriter, r *http.Request) {
+		at, _ := strconv.ParseInt(r.URL.Query().Get("at"), 10, 64)
+		if r.Method != http.MethodPost || at <= hostUs()+f.offsetUs {
+			http.Error(w, `{"error":"at in the past"}`, http.StatusConflict)
+			return
+		}
+		f.mu.Lock()
+		defer f.mu.Unlock()
+		if f.running {
+			http.Error(w, `{"error":"running"}`, http.StatusConflict)
+			return
+		}
+		f.running = true
+		f.runs = append(f.runs, runReq{r.URL.Query().Get("n"), at})
+		w.Write([]byte(`{"ok":true}`))
+	})
+	mux.HandleFunc("/status", func(w http.ResponseWriter, r *http.Request) {
+		w.Write([]byte(`{"id":"x","running":true,"step":3,"count":9,"loops_left":-1,"hid_q_max":40,"hid_underruns":2}`))
+	})
+	f.srv = httptest.NewServer(mux)
+	t.Cleanup(f.srv.Close)
+	return f, Device{Name: fmt.Sprintf("fake%+d", offsetUs), Addr: strings.TrimPrefix(f.srv.URL, "http://")}
+}
+
+func TestSyncClock(t *testing.T) {
+	f, d := newFakeDev(t, 5_000_000)
+	f.slowFirst = 3
+	c, err := syncClock(d, 8)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if c.rttUs >= 30_000 {
+		t.Fatalf("ficou com uma amostra lenta: rtt %d µs", c.rttUs)
+	}
+	if diff := c.offsetUs - f.offsetUs; diff < -c.rttUs || diff > c.rttUs {
+		t.Fatalf("offset %d, quer %d ± %d", c.offsetUs, f.offsetUs, c.rttUs)
+	}
+
+	dead := Device{Name: "dead", Addr: "127.0.0.1:1"}
+	if _, err := syncClock(dead, 2); err == nil {
+		t.Fatal("device inalcançável sem erro")
+	}
+}
+
+func TestCmdStartAligns(t *testing.T) {
+	offsets := []int64{3_000_000, -7_000_000, 123_456}
+	var fakes []*fakeDev
+	var devs []Device
+	for _, o := range offsets {
+		f, d := newFakeDev(t, o)
+		fakes = append(fakes, f)
+		devs = append(devs, d)
+	}
+	dead := Device{Name: "dead", Addr: "127.0.0.1:1"}
+	lead := 300 * time.Millisecond
+	before := hostUs()
+	if fails := cmdStart(append(devs, dead), 5, lead, 6); fails != 1 {
+		t.Fatalf("fails = %d, quer 1 (só o inalcançável)", fails)
+	}
+	// o instante pedido a cada device, de volta no relógio do host, é o mesmo para todos
+	var hostAt []int64
+	for i, f := range fakes {
+		if len(f.runs) != 1 || f.runs[0].n != "5" {
+			t.Fatalf("device %d: runs %v", i, f.runs)
+		}
+		hostAt = append(hostAt, f.runs[0].at-f.offsetUs)
+	}
+	for i := 1; i < len(hostAt); i++ {
+		if d := hostAt[i] - hostAt[0]; d < -2000 || d > 2000 {
+			t.Fatalf("desalinhado %d µs entre device 0 e %d", d, i)
+		}
+	}
+	if d := hostAt[0] - before; d < lead.Microseconds() || d > lead.Microseconds()+200_000 {
+		t.Fatalf("início %d µs depois, quer ~%d", d, lead.Microseconds())
+	}
+}
+
+func TestCmdStartBusyNotArmed(t *testing.T) {
+	idle, a := newFakeDev(t, 0)
+	busy, b := newFakeDev(t, 2_000_000)
+	busy.running = true
+	if fails := cmdStart([]Device{a, b}, 3, 200*time.Millisecond, 4); fails != 1 {
+		t.Fatalf("fails = %d, quer 1 (a placa rodando)", fails)
+	}
+	if len(idle.runs) != 1 || len(busy.runs) != 0 {
+		t.Fatalf("runs: livre %v, rodando %v", idle.runs, busy.runs)
+	}
+	// um segundo start pega as duas ocupadas
+	if fails := cmdStart([]Device{a, b}, 3, 200*time.Millisecond, 4); fails != 2 {
+		t.Fatalf("fails = %d, quer 2", fails)
+	}
+}
+
+func TestCmdStatus(t *testing.T) {
+	_, a := newFakeDev(t, 0)
+	_, b := newFakeDev(t, 0)
+	if fails := cmdStatus([]Device{a, b}); fails != 0 {
+		t.Fatalf("fails = %d", fails)
+	}
+	if fails := cmdStatus([]Device{a, {Name: "dead", Addr: "127.0.0.1:1"}}); fails != 1 {
+		t.Fatalf("fails = %d, quer 1", fails)
+	}
+}
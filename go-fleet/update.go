@@ -0,0 +1,227 @@
+package main
+
+import (
+	"bytes"
+	"crypto/md5"
+	"encoding/hex"
+	"encoding/json"
+	"errors"
+	"fmt"
+	"hash/crc32"
+	"io"
+	"log"
+	"mime/multipart"
+	"net/http"
+	"os"
+	"path/filepath"
+	"strconv"
+	"strings"
+	"time"
+)
+
+// ================= Macro em delta =================
+
+// Passo com os mesmos defaults de stepFromJson() no firmware.
+type rawStep struct {
+	Type    string  `json:"type"`
+	X       int     `json:"x"`
+	Y       int     `json:"y"`
+	X2      int     `json:"x2"`
+	Y2      int     `json:"y2"`
+	Text    string  `json:"text"`
+	Btn     *string `json:"btn"`
+	Button  *string `json:"button"`
+	DelayMs *int    `json:"delayMs"`
+	Ms      *int    `json:"ms"`
+	DurMs   *int    `json:"durMs"`
+	StepsN  *int    `json:"stepsN"`
+	Jit     *int    `json:"jit"`
+}
+
+func orInt(p *int, def int) int {
+	if p != nil {
+		return *p
+	}
+	return def
+}
+
+// Igual a stepCanon() no firmware: campos separados por 0x1F.
+func (s rawStep) canon() string {
+	btn := "left"
+	if s.Btn != nil {
+		btn = *s.Btn
+	} else if s.Button != nil {
+		btn = *s.Button
+	}
+	delay := orInt(s.DelayMs, orInt(s.Ms, 0))
+	stepsN := orInt(s.StepsN, 1)
+	if stepsN < 1 {
+		stepsN = 1
+	}
+	it := strconv.Itoa
+	return strings.Join([]string{
+		s.Type, it(s.X), it(s.Y), it(s.X2), it(s.Y2), s.Text, btn,
+		it(delay), it(orInt(s.DurMs, 600)), it(stepsN), it(orInt(s.Jit, -1)),
+	}, "\x1f")
+}
+
+func hex32(v uint32) string { return fmt.Sprintf("%08x", v) }
+
+// CRC32 de cada passo e da macro (encadeado sobre "canon\n"), como stepCrc()/macroCrc() no firmware.
+func macroCrcs(raws []json.RawMessage) ([]string, string, error) {
+	crcs := make([]string, len(raws))
+	var total uint32
+	for i, r := range raws {
+		var s rawStep
+		if err := json.Unmarshal(r, &s); err != nil {
+			return nil, "", fmt.Errorf("passo %d: %w", i, err)
+		}
+		c := s.canon()
+		crcs[i] = hex32(crc32.ChecksumIEEE([]byte(c)))
+		total = crc32.Update(total, crc32.IEEETable, []byte(c+"\n"))
+	}
+	return crcs, hex32(total), nil
+}
+
+type deltaSet struct {
+	I    int             `json:"i"`
+	Step json.RawMessage `json:"step"`
+}
+
+type deltaBundle struct {
+	Base string     `json:"base"`
+	N    int        `json:"n"`
+	Set  []deltaSet `json:"set"`
+	Crc  string     `json:"crc"`
+}
+
+type manifest struct {
+	N     int      `json:"n"`
+	Crc   string   `json:"crc"`
+	Steps []string `json:"steps"`
+}
+
+// Compara o manifest do device com a macro local e monta o delta.
+func buildDelta(m manifest, raws []json.RawMessage, crcs []string, total string) deltaBundle {
+	b := deltaBundle{Base: m.Crc, N: len(raws), Crc: total, Set: []deltaSet{}}
+	for i, c := range crcs {
+		if i >= len(m.Steps) || m.Steps[i] != c {
+			b.Set = append(b.Set, deltaSet{I: i, Step: raws[i]})
+		}
+	}
+	return b
+}
+
+// Tentativas extras de delta quando a base muda no caminho (409).
+const deltaRetries = 2
+
+func cmdPushDelta(devs []Device, file string) int {
+	data, err := os.ReadFile(file)
+	if err != nil {
+		log.Fatal(err)
+	}
+	var m struct {
+		Steps []json.RawMessage `json:"steps"`
+	}
+	if err := json.Unmarshal(data, &m); err != nil || m.Steps == nil {
+		log.Fatalf("%s: esperado JSON com \"steps\" (formato do /export)", file)
+	}
+	crcs, total, err := macroCrcs(m.Steps)
+	if err != nil {
+		log.Fatalf("%s: %v", file, err)
+	}
+	return forEach(devs, func(d Device) (string, error) {
+		// 409 = a base mudou entre o manifest e o POST (outro push/edição na placa): relê o manifest e
+		// refaz o delta. Nunca cai para /steps/set, que trocaria a macro no meio de um loop.
+		for try := 0; ; try++ {
+			var man manifest
+			if err := call(http.MethodGet, d, "/macro/manifest", nil, &man); err != nil {
+				return "", err
+			}
+			if man.Crc == total {
+				return "já atualizado", nil
+			}
+			b := buildDelta(man, m.Steps, crcs, total)
+			body, _ := json.Marshal(b)
+			var r struct {
+				Applied bool `json:"applied"`
+			}
+			err := call(http.MethodPost, d, "/macro/delta", body, &r)
+			var he *httpError
+			if errors.As(err, &he) && he.Code == http.StatusConflict && try < deltaRetries {
+				continue
+			}
+			if err != nil {
+				return "", err
+			}
+			when := "aplicado"
+			if !r.Applied {
+				when = "aplica no fim do loop"
+			}
+			return fmt.Sprintf("delta %d/%d passos, %d bytes (completo %d), %s", len(b.Set), len(m.Steps), len(body), len(data), when), nil
+		}
+	})
+}
+
+// ================= OTA =================
+
+var otaClient = &http.Client{Timeout: 2 * time.Minute}
+
+// Primeiro endereço que aparece em mais de um device (vazio se nenhum): placas com o mesmo IP
+// fixo respondem todas no mesmo ip:porta.
+func dupAddr(devs []Device) string {
+	seen := map[string]bool{}
+	for _, d := range devs {
+		if seen[d.Addr] {
+			return d.Addr
+		}
+		seen[d.Addr] = true
+	}
+	return ""
+}
+
+func cmdOTA(devs []Device, file string) int {
+	fw, err := os.ReadFile(file)
+	if err != nil {
+		log.Fatal(err)
+	}
+	// o mesmo binário vai para todas: o IP de cada placa vem do Preferences dela (UI: IP fixo ou DHCP).
+	// Duas placas no mesmo endereço não dão para distinguir nem conferir depois do reboot.
+	if h := dupAddr(devs); h != "" {
+		fmt.Fprintf(os.Stderr, "ota: %s responde por mais de uma placa; configure IP fixo distinto (ou DHCP) em cada uma\n", h)
+		return len(devs)
+	}
+	sum := md5.Sum(fw)
+	sumHex := hex.EncodeToString(sum[:])
+	return forEach(devs, func(d Device) (string, error) {
+		var body bytes.Buffer
+		mw := multipart.NewWriter(&body)
+		part, err := mw.CreateFormFile("firmware", filepath.Base(file))
+		if err != nil {
+			return "", err
+		}
+		part.Write(fw)
+		mw.Close()
+		req, err := http.NewRequest(http.MethodPost, "http://"+d.Addr+"/ota?md5="+sumHex, &body)
+		if err != nil {
+			return "", err
+		}
+		req.Header.Set("Content-Type", mw.FormDataContentType())
+		resp, err := otaClient.Do(req)
+		if err != nil {
+			return "", err
+		}
+		defer resp.Body.Close()
+		data, _ := io.ReadAll(resp.Body)
+		if resp.StatusCode >= 400 {
+			return "", &httpError{resp.StatusCode, strings.TrimSpace(string(data))}
+		}
+		var r struct {
+			Bytes int    `json:"bytes"`
+			Ms    int    `json:"ms"`
+			Apply string `json:"apply"`
+		}
+		_ = json.Unmarshal(data, &r)
+		return fmt.Sprintf("ok %d bytes em %d ms, reinicia: %s", r.Bytes, r.Ms, r.Apply), nil
+	})
+}
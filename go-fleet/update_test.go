@@ -0,0 +1,318 @@
+package main
+
+import (
+	"crypto/md5"
+	"encoding/hex"
+	"encoding/json"
+	"fmt"
+	"io"
+	"net/http"
+	"net/http/httptest"
+	"os"
+	"path/filepath"
+	"strings"
+	"sync"
+	"testing"
+)
+
+// Vetores calculados pelo firmware (stepCanon/stepCrc/macroCrc em firmware/src/macro.h);
+// os mesmos valores estão fixados em firmware/test/host/test_canon.cpp.
+var fwStepCrc = []string{"dedc1811", "0152cc35", "b2fdce4b", "2c9f73f2"}
+
+const fwMacroCrc = "bec468b9"
+
+func TestCanonMatchesFirmware(t *testing.T) {
+	cases := []struct {
+		json string
+		want string
+	}{
+		// defaults de stepFromJson: btn left, delay 0, durMs 600, stepsN 1, jit -1
+		{`{"type":"tap"}`, fwStepCrc[0]},
+		{`{"type":"tap","x":0,"btn":"left","delayMs":0,"durMs":600,"stepsN":1,"jit":-1}`, fwStepCrc[0]},
+		{`{"type":"tap","btn":null,"ms":null}`, fwStepCrc[0]},
+		// button x btn, ms x delayMs
+		{`{"type":"tap","x":10,"y":-5,"button":"right","ms":250}`, fwStepCrc[1]},
+		{`{"type":"tap","x":10,"y":-5,"btn":"right","delayMs":250}`, fwStepCrc[1]},
+		{`{"type":"tap","x":10,"y":-5,"btn":"right","button":"middle","delayMs":250,"ms":7}`, fwStepCrc[1]},
+		// stepsN 0 (ou negativo) vira 1; delayMs ganha de ms
+		{`{"type":"drag","x":1,"y":2,"x2":300,"y2":400,"delayMs":40,"ms":999,"durMs":900,"stepsN":0,"jit":0}`, fwStepCrc[2]},
+		{`{"type":"drag","x":1,"y":2,"x2":300,"y2":400,"ms":40,"durMs":900,"stepsN":-3,"jit":0}`, fwStepCrc[2]},
+		{`{"type":"type","text":"olá, mundo","delayMs":5}`, fwStepCrc[3]},
+		// campos desconhecidos (ex.: o antigo "keep") não entram na forma canônica
+		{`{"type":"type","text":"olá, mundo","delayMs":5,"keep":1}`, fwStepCrc[3]},
+	}
+	for _, c := range cases {
+		crcs, _, err := macroCrcs([]json.RawMessage{json.RawMessage(c.json)})
+		if err != nil {
+			t.Fatalf("%s: %v", c.json, err)
+		}
+		if crcs[0] != c.want {
+			t.Errorf("%s: crc %s, firmware %s", c.json, crcs[0], c.want)
+		}
+	}
+}
+
+func TestMacroCrcChained(t *testing.T) {
+	raws := []json.RawMessage{
+		json.RawMessage(`{"type":"tap"}`),
+		json.RawMessage(`{"type":"tap","x":10,"y":-5,"button":"right","ms":250}`),
+		json.RawMessage(`{"type":"drag","x":1,"y":2,"x2":300,"y2":400,"delayMs":40,"durMs":900,"stepsN":0,"jit":0}`),
+		json.RawMessage(`{"type":"type","text":"olá, mundo","delayMs":5}`),
+	}
+	crcs, total, err := macroCrcs(raws)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if fmt.Sprint(crcs) != fmt.Sprint(fwStepCrc) || total != fwMacroCrc {
+		t.Fatalf("crcs %v total %s, firmware %v %s", crcs, total, fwStepCrc, fwMacroCrc)
+	}
+	if _, empty, _ := macroCrcs(nil); empty != "00000000" {
+		t.Fatalf("macro vazia: %s", empty)
+	}
+	if _, _, err := macroCrcs([]json.RawMessage{json.RawMessage(`{"x":"a"}`)}); err == nil {
+		t.Fatal("passo inválido aceito")
+	}
+}
+
+func raws(n int) []json.RawMessage {
+	out := make([]json.RawMessage, n)
+	for i := range out {
+		out[i] = json.RawMessage(fmt.Sprintf(`{"type":"tap","x":%d}`, i))
+	}
+	return out
+}
+
+func setIdx(b deltaBundle) []int {
+	var out []int
+	for _, s := range b.Set {
+		out = append(out, s.I)
+	}
+	return out
+}
+
+func TestBuildDelta(t *testing.T) {
+	dev := manifest{N: 3, Crc: "base", Steps: []string{"a", "b", "c"}}
+	cases := []struct {
+		name string
+		crcs []string
+		want []int
+	}{
+		{"igual", []string{"a", "b", "c"}, nil},
+		{"cresce", []string{"a", "b", "c", "d", "e"}, []int{3, 4}},
+		{"encolhe", []string{"a", "b"}, nil}, // só n diminui
+		{"encolhe e edita", []string{"a", "x"}, []int{1}},
+		{"edição no lugar", []string{"a", "x", "c"}, []int{1}},
+		{"inserção no meio", []string{"a", "n", "b", "c"}, []int{1, 2, 3}},
+		{"de vazio", []string{"a"}, []int{0}},
+	}
+	for _, c := range cases {
+		m := dev
+		if c.name == "de vazio" {
+			m = manifest{Crc: "00000000"}
+		}
+		b := buildDelta(m, raws(len(c.crcs)), c.crcs, "novo")
+		if fmt.Sprint(setIdx(b)) != fmt.Sprint(c.want) || b.N != len(c.crcs) || b.Base != m.Crc || b.Crc != "novo" {
+			t.Errorf("%s: set %v n %d base %s crc %s", c.name, setIdx(b), b.N, b.Base, b.Crc)
+		}
+		for _, s := range b.Set {
+			if string(s.Step) != string(raws(len(c.crcs))[s.I]) {
+				t.Errorf("%s: passo %d com corpo %s", c.name, s.I, s.Step)
+			}
+		}
+		if body, _ := json.Marshal(b); !strings.Contains(string(body), `"set":[`) {
+			t.Errorf("%s: set precisa ser lista, não null: %s", c.name, body)
+		}
+	}
+}
+
+// ================= device falso de delta/OTA =================
+
+type fakeUpdate struct {
+	manifests  []manifest // um por GET /macro/manifest (o último se repete)
+	deltaCodes []int      // status de cada /macro/delta (o último se repete; 0 = 200)
+	mu         sync.Mutex
+	gets       int
+	deltas     []deltaBundle
+	fullSets   [][]byte
+	ota        []string // "nome md5 bytes"
+}
+
+// próximo item da sequência; o último se repete
+func nth[T any](xs []T, i int) T {
+	var zero T
+	if len(xs) == 0 {
+		return zero
+	}
+	return xs[min(i, len(xs)-1)]
+}
+
+func newFakeUpdate(t *testing.T, f *fakeUpdate) Device {
+	mux := http.NewServeMux()
+	mux.HandleFunc("/macro/manifest", func(w http.ResponseWriter, r *http.Request) {
+		f.mu.Lock()
+		m := nth(f.manifests, f.gets)
+		f.gets++
+		f.mu.Unlock()
+		json.NewEncoder(w).Encode(m)
+	})
+	mux.HandleFunc("/macro/delta", func(w http.ResponseWriter, r *http.Request) {
+		var b deltaBundle
+		if err := json.NewDecoder(r.Body).Decode(&b); err != nil {
+			http.Error(w, `{"error":"json"}`, http.StatusBadRequest)
+			return
+		}
+		f.mu.Lock()
+		code := nth(f.deltaCodes, len(f.deltas))
+		f.deltas = append(f.deltas, b)
+		f.mu.Unlock()
+		if code != 0 && code != http.StatusOK {
+			http.Error(w, `{"error":"base mismatch"}`, code)
+			return
+		}
+		w.Write([]byte(`{"ok":true,"applied":true}`))
+	})
+	mux.HandleFunc("/steps/set", func(w http.ResponseWriter, r *http.Request) {
+		body, _ := io.ReadAll(r.Body)
+		f.mu.Lock()
+		f.fullSets = append(f.fullSets, body)
+		f.mu.Unlock()
+		w.Write([]byte(`{"ok":true}`))
+	})
+	mux.HandleFunc("/ota", func(w http.ResponseWriter, r *http.Request) {
+		file, hdr, err := r.FormFile("firmware")
+		if err != nil {
+			http.Error(w, `{"error":"no file"}`, http.StatusBadRequest)
+			return
+		}
+		data, _ := io.ReadAll(file)
+		sum := md5.Sum(data)
+		if r.URL.Query().Get("md5") != hex.EncodeToString(sum[:]) {
+			http.Error(w, `{"error":"md5"}`, http.StatusInternalServerError)
+			return
+		}
+		f.mu.Lock()
+		f.ota = append(f.ota, fmt.Sprintf("%s %s %d", hdr.Filename, r.URL.Query().Get("md5"), len(data)))
+		f.mu.Unlock()
+		fmt.Fprintf(w, `{"ok":true,"bytes":%d,"ms":12,"apply":"now"}`, len(data))
+	})
+	srv := httptest.NewServer(mux)
+	t.Cleanup(srv.Close)
+	return Device{Name: "fake", Addr: strings.TrimPrefix(srv.URL, "http://")}
+}
+
+func writeMacro(t *testing.T, steps []json.RawMessage) (string, []byte) {
+	data, _ := json.Marshal(map[string]any{"steps": steps})
+	p := filepath.Join(t.TempDir(), "macro.json")
+	if err := os.WriteFile(p, data, 0o644); err != nil {
+		t.Fatal(err)
+	}
+	return p, data
+}
+
+func TestPushDelta(t *testing.T) {
+	steps := raws(4)
+	crcs, total, _ := macroCrcs(steps)
+	file, _ := writeMacro(t, steps)
+
+	// device com os 3 primeiros iguais e o 2 diferente: manda só 2 e 3
+	f := &fakeUpdate{manifests: []manifest{{N: 3, Crc: "cafef00d", Steps: []string{crcs[0], crcs[1], "00000000"}}}}
+	d := newFakeUpdate(t, f)
+	if fails := cmdPushDelta([]Device{d}, file); fails != 0 {
+		t.Fatalf("fails = %d", fails)
+	}
+	if len(f.deltas) != 1 || fmt.Sprint(setIdx(f.deltas[0])) != "[2 3]" || f.deltas[0].Base != "cafef00d" ||
+		f.deltas[0].Crc != total || f.deltas[0].N != 4 || len(f.fullSets) != 0 {
+		t.Fatalf("delta %+v, completos %d", f.deltas, len(f.fullSets))
+	}
+
+	// já atualizado: nenhum POST
+	same := &fakeUpdate{manifests: []manifest{{N: 4, Crc: total, Steps: crcs}}}
+	if fails := cmdPushDelta([]Device{newFakeUpdate(t, same)}, file); fails != 0 || len(same.deltas)+len(same.fullSets) != 0 {
+		t.Fatalf("atualizado: fails %d, deltas %d, completos %d", fails, len(same.deltas), len(same.fullSets))
+	}
+}
+
+func TestPushDeltaConflictRefetchesManifest(t *testing.T) {
+	steps := raws(3)
+	crcs, total, _ := macroCrcs(steps)
+	file, _ := writeMacro(t, steps)
+
+	// a base muda entre o primeiro manifest e o POST (ex.: um delta já pendente na placa):
+	// relê o manifest, manda o delta contra a base nova e nunca usa /steps/set
+	f := &fakeUpdate{
+		manifests:  []manifest{{N: 1, Crc: "0badbase", Steps: []string{"x"}}, {N: 2, Crc: "57a9ed00", Steps: crcs[:2]}},
+		deltaCodes: []int{http.StatusConflict, http.StatusOK},
+	}
+	if fails := cmdPushDelta([]Device{newFakeUpdate(t, f)}, file); fails != 0 {
+		t.Fatalf("fails = %d", fails)
+	}
+	if f.gets != 2 || len(f.deltas) != 2 || len(f.fullSets) != 0 {
+		t.Fatalf("manifests %d, deltas %d, completos %d", f.gets, len(f.deltas), len(f.fullSets))
+	}
+	if f.deltas[0].Base != "0badbase" || f.deltas[1].Base != "57a9ed00" || fmt.Sprint(setIdx(f.deltas[1])) != "[2]" || f.deltas[1].Crc != total {
+		t.Fatalf("deltas %+v", f.deltas)
+	}
+
+	// a placa já ficou com a macro enquanto isso: nada a mandar na segunda volta
+	done := &fakeUpdate{
+		manifests:  []manifest{{N: 1, Crc: "0badbase"}, {N: 3, Crc: total, Steps: crcs}},
+		deltaCodes: []int{http.StatusConflict},
+	}
+	if fails := cmdPushDelta([]Device{newFakeUpdate(t, done)}, file); fails != 0 || len(done.deltas) != 1 {
+		t.Fatalf("já aplicada: fails %d, deltas %d", fails, len(done.deltas))
+	}
+
+	// 409 que não passa: desiste depois das tentativas, sem push completo
+	stuck := &fakeUpdate{manifests: f.manifests[:1], deltaCodes: []int{http.StatusConflict}}
+	if fails := cmdPushDelta([]Device{newFakeUpdate(t, stuck)}, file); fails != 1 ||
+		len(stuck.deltas) != 1+deltaRetries || stuck.gets != 1+deltaRetries || len(stuck.fullSets) != 0 {
+		t.Fatalf("409 fixo: fails %d, deltas %d, manifests %d, completos %d", fails, len(stuck.deltas), stuck.gets, len(stuck.fullSets))
+	}
+
+	// outro erro não tenta de novo
+	bad := &fakeUpdate{manifests: f.manifests[:1], deltaCodes: []int{http.StatusBadRequest}}
+	if fails := cmdPushDelta([]Device{newFakeUpdate(t, bad)}, file); fails != 1 || len(bad.deltas) != 1 || len(bad.fullSets) != 0 {
+		t.Fatalf("400: fails %d, deltas %d, completos %d", fails, len(bad.deltas), len(bad.fullSets))
+	}
+}
+
+func TestOTAUpload(t *testing.T) {
+	fw := make([]byte, 300_000)
+	for i := range fw {
+		fw[i] = byte(i * 7)
+	}
+	p := filepath.Join(t.TempDir(), "firmware.bin")
+	if err := os.WriteFile(p, fw, 0o644); err != nil {
+		t.Fatal(err)
+	}
+	sum := md5.Sum(fw)
+	a, b := &fakeUpdate{}, &fakeUpdate{}
+	if fails := cmdOTA([]Device{newFakeUpdate(t, a), newFakeUpdate(t, b)}, p); fails != 0 {
+		t.Fatalf("fails = %d", fails)
+	}
+	want := fmt.Sprintf("firmware.bin %s %d", hex.EncodeToString(sum[:]), len(fw))
+	for _, f := range []*fakeUpdate{a, b} {
+		if len(f.ota) != 1 || f.ota[0] != want {
+			t.Fatalf("ota %v, quer %s", f.ota, want)
+		}
+	}
+	// duas placas no mesmo IP (o mDNS devolve o mesmo endereço para as duas): recusa antes de mandar
+	c := &fakeUpdate{}
+	dc := newFakeUpdate(t, c)
+	twin := Device{Name: "twin", Addr: dc.Addr}
+	if fails := cmdOTA([]Device{dc, twin}, p); fails != 2 || len(c.ota) != 0 {
+		t.Fatalf("IP duplicado: fails %d, ota %v", fails, c.ota)
+	}
+	if h := dupAddr([]Device{{Addr: "10.0.0.1:80"}, {Addr: "10.0.0.2:80"}, {Addr: "10.0.0.1:80"}}); h != "10.0.0.1:80" {
+		t.Fatalf("dupAddr = %q", h)
+	}
+	if h := dupAddr([]Device{{Addr: "10.0.0.1:80"}, {Addr: "10.0.0.2:80"}}); h != "" {
+		t.Fatalf("dupAddr = %q", h)
+	}
+
+	// device inalcançável conta como falha; os outros recebem normalmente
+	dead := Device{Name: "dead", Addr: "127.0.0.1:1"}
+	if fails := cmdOTA([]Device{newFakeUpdate(t, &fakeUpdate{}), dead}, p); fails != 1 {
+		t.Fatalf("fails = %d, quer 1", fails)
+	}
+}